@@ -0,0 +1,106 @@
+#pragma once
+
+#include "MatrixOperations.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace tulip::text {
+	// binary image packed 64 pixels per word, every row starting on a word boundary
+	// bits past the width stay zero
+	class BitMatrix {
+		size_t m_width;
+		size_t m_height;
+		size_t m_stride;
+		std::vector<uint64_t> m_words;
+
+	public:
+		BitMatrix(size_t width, size_t height) :
+			m_width(width),
+			m_height(height),
+			m_stride((width + 63) / 64),
+			m_words(m_stride * height, 0) {}
+
+		// every nonzero entry set, for kernels whose nonzero entries are all weight
+		static BitMatrix fromValues(double const* values, size_t width, size_t height);
+
+		size_t width() const {
+			return m_width;
+		}
+
+		size_t height() const {
+			return m_height;
+		}
+
+		size_t stride() const {
+			return m_stride;
+		}
+
+		uint64_t const* row(size_t y) const {
+			return m_words.data() + y * m_stride;
+		}
+
+		bool get(size_t x, size_t y) const {
+			return (this->row(y)[x / 64] >> (x % 64)) & 1;
+		}
+
+		void set(size_t x, size_t y) {
+			m_words[y * m_stride + x / 64] |= uint64_t(1) << (x % 64);
+		}
+
+		void clear() {
+			std::fill(m_words.begin(), m_words.end(), 0);
+		}
+
+		size_t count() const;
+
+		// the 64 pixels of row y starting at x, zero outside the matrix
+		uint64_t bits(size_t y, int64_t x) const {
+			auto const words = this->row(y);
+			auto const index = x >> 6;
+			auto const shift = x & 63;
+
+			auto word = [&](int64_t i) -> uint64_t {
+				return i >= 0 && i < int64_t(m_stride) ? words[i] : 0;
+			};
+			if (shift == 0) {
+				return word(index);
+			}
+			return (word(index) >> shift) | (word(index + 1) << (64 - shift));
+		}
+	};
+
+	// a field that is background everywhere, outside its bounds included,
+	// plus the weight of every plane covering a pixel
+	struct BinaryField {
+		size_t width;
+		size_t height;
+		double background;
+		std::vector<BitMatrix> planes;
+		std::vector<double> weights;
+
+		BinaryField(size_t width, size_t height, double background) :
+			width(width),
+			height(height),
+			background(background) {}
+
+		size_t addPlane(double weight) {
+			planes.emplace_back(width, height);
+			weights.push_back(weight);
+			return planes.size() - 1;
+		}
+	};
+
+	// whether and+popcount over the kernel rows beats a batched fft of fftWidth x fftHeight
+	// for scoring every placement of one kernel
+	bool prefersDirect(
+		BinaryField const& field, size_t kernelWidth, size_t kernelHeight, size_t fftWidth, size_t fftHeight
+	);
+
+	// scores every placement of a binary kernel with weight on its set pixels
+	// same layout as BatchedCorrelation: entry (x, y) is the placement at
+	// (x - kernelWidth + 1, y - kernelHeight + 1)
+	// map must be (field.width + kernel.width() - 1) x (field.height + kernel.height() - 1)
+	void correlateDirect(BinaryField const& field, BitMatrix const& kernel, double weight, Matrix<double>& map);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "MatrixOperations.hpp"
+#include "ObjectKernel.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace tulip::text {
+	struct PixelChange {
+		int32_t x;
+		int32_t y;
+		double delta;
+	};
+
+	// keeps the full correlation of every kernel with an input across placements
+	// after a placement only the entries whose footprint covers a changed pixel are updated
+	// inactive kernels get an empty map and are never updated
+	// peaks skip the placements crossing a clipped edge of the input
+	class CorrelationMaps {
+		struct Tap {
+			int32_t x;
+			int32_t y;
+			double weight;
+		};
+
+		std::vector<Matrix<double>> m_maps;
+		std::vector<std::vector<Tap>> m_taps;
+		std::vector<std::pair<size_t, size_t>> m_extents;
+		std::vector<bool> m_nonNegative;
+		size_t m_totalTaps = 0;
+		ClippedEdges m_clipped;
+
+	public:
+		CorrelationMaps(
+			std::vector<ObjectKernel> const& kernels, std::vector<bool> const& active, size_t inputWidth,
+			size_t inputHeight, ClippedEdges clipped = {}
+		);
+
+		// bytes the maps of the active kernels take
+		static size_t memory(
+			std::vector<ObjectKernel> const& kernels, std::vector<bool> const& active, size_t inputWidth,
+			size_t inputHeight
+		);
+
+		size_t size() const {
+			return m_maps.size();
+		}
+
+		Matrix<double>& operator[](size_t kernel) {
+			return m_maps[kernel];
+		}
+
+		Matrix<double> const& operator[](size_t kernel) const {
+			return m_maps[kernel];
+		}
+
+		std::pair<size_t, size_t> extent(size_t kernel) const {
+			return m_extents[kernel];
+		}
+
+		// whether removing input can only lower this kernel's scores
+		bool nonNegative(size_t kernel) const {
+			return m_nonNegative[kernel];
+		}
+
+		// multiply-adds needed to apply changes to every map
+		size_t updateCost(size_t changes) const {
+			return changes * m_totalTaps;
+		}
+
+		void update(size_t kernel, std::vector<PixelChange> const& changes);
+
+		// the peak findPeak reports, and in maximum the highest entry it scans, never below zero
+		// the tolerance rule can report another position once entries drop, maximum bounds all of them
+		CorrelationPeak peak(size_t kernel, double tolerance, double& maximum) const;
+	};
+}
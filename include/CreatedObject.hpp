@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 namespace tulip::text {
 	struct CreatedObject {
 		double x;
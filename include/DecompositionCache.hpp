@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <ghc/fs_fwd.hpp>
+#include <list>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace tulip::text {
+	struct ConvolutionScore {
+		double score = 0.0f;
+		int32_t x = 0;
+		int32_t y = 0;
+		size_t kernelId = 0;
+	};
+
+	// everything a glyph's greedy decomposition depends on
+	struct DecompositionKey {
+		uint64_t fontHash = 0;
+		double fontSize = 0.0;
+		char32_t codepoint = 0;
+		uint64_t kernelHash = 0;
+		double minScore = 0.0;
+		double negativeScore = 0.0;
+		int32_t objectsPerGlyph = 0;
+		int32_t precision = 0;
+		int32_t rasterBackend = 0;
+		int32_t pyramidFactor = 1;
+		int32_t pyramidCandidates = 0;
+		// incremental scoring places one kernel at a time, placementBatch is 1 with it
+		bool incrementalScoring = false;
+		int32_t placementBatch = 1;
+		double batchOverlap = 0.0;
+		// the post pass tolerance, below zero when it did not run
+		double objectTolerance = -1.0;
+
+		auto operator<=>(DecompositionKey const&) const = default;
+
+		// stable across sessions, used to name the file of a persisted entry
+		uint64_t hash() const;
+	};
+
+	// least recently used decompositions in memory, optionally backed by one file per entry
+	class DecompositionCache {
+		using Entry = std::pair<DecompositionKey, std::vector<ConvolutionScore>>;
+
+		std::mutex m_mutex;
+		size_t m_capacity;
+		// most recently used first
+		std::list<Entry> m_entries;
+		std::map<DecompositionKey, std::list<Entry>::iterator> m_index;
+		std::optional<ghc::filesystem::path> m_directory;
+
+		void remember(DecompositionKey const& key, std::vector<ConvolutionScore> scores);
+		std::optional<std::vector<ConvolutionScore>> load(DecompositionKey const& key) const;
+		void save(DecompositionKey const& key, std::vector<ConvolutionScore> const& scores) const;
+
+	public:
+		DecompositionCache(size_t capacity);
+
+		// persist entries in directory, or keep them in memory only with nullopt
+		void setDirectory(std::optional<ghc::filesystem::path> directory);
+
+		std::optional<std::vector<ConvolutionScore>> find(DecompositionKey const& key);
+		void insert(DecompositionKey const& key, std::vector<ConvolutionScore> scores);
+
+		void clear();
+
+		// fnv-1a of the file contents, 0 if it can not be read
+		static uint64_t hashFile(ghc::filesystem::path const& path);
+	};
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "GeneratorConfig.hpp"
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace tulip::text {
+	// coverage of one rasterized glyph, row-major alpha over its texture rect
+	struct GlyphBitmap {
+		sf::Glyph glyph;
+		size_t width = 0;
+		size_t height = 0;
+		std::vector<uint8_t> alpha;
+	};
+
+	// fonts stay loaded and glyphs stay rasterized for the whole session
+	class FontCache {
+		struct FreeType;
+
+		std::mutex m_mutex;
+		std::map<std::string, std::unique_ptr<sf::Font>> m_fonts;
+		std::map<std::tuple<std::string, unsigned, char32_t, RasterBackend>, std::shared_ptr<GlyphBitmap const>> m_glyphs;
+		std::unique_ptr<FreeType> m_freeType;
+
+		sf::Font* loadFont(std::string const& path);
+
+		std::vector<std::shared_ptr<GlyphBitmap>> rasterizeSfml(
+			sf::Font& font, unsigned size, std::vector<char32_t> const& codepoints
+		);
+		std::vector<std::shared_ptr<GlyphBitmap>> rasterizeFreeType(
+			std::string const& path, unsigned size, std::vector<char32_t> const& codepoints
+		);
+
+	public:
+		FontCache();
+		~FontCache();
+
+		static FontCache& get();
+
+		// nullptr if the font can not be loaded
+		sf::Font* font(std::string const& path);
+
+		// bitmaps in the order of codepoints, empty if the font can not be loaded
+		// missing sfml glyphs are rasterized together so the atlas is read back at most once
+		std::vector<std::shared_ptr<GlyphBitmap const>> glyphs(
+			std::string const& path, unsigned size, std::vector<char32_t> const& codepoints,
+			RasterBackend backend = RasterBackend::Sfml
+		);
+
+		// origin of every character of a single line layout, what sf::Text::findCharacterPos returns
+		// empty if the font can not be loaded
+		std::vector<sf::Vector2f> characterPositions(
+			std::string const& path, unsigned size, std::u32string const& text,
+			RasterBackend backend = RasterBackend::Sfml
+		);
+
+		void clear();
+	};
+}
@@ -3,10 +3,55 @@
 #include "CreatedObject.hpp"
 #include "GeneratorConfig.hpp"
 
+#include <chrono>
+#include <functional>
 #include <memory>
+#include <optional>
 #include <vector>
 
 namespace tulip::text {
+	struct GenerationProgress {
+		// glyphs in per glyph layout, tiles and seams in whole string layout
+		size_t finished = 0;
+		size_t total = 0;
+		size_t objects = 0;
+		// objects before optimizeObjects merged and dropped some, cached glyphs count as optimized
+		size_t placedObjects = 0;
+		// fraction of the text's glyph pixels the objects cover, known once generation stops
+		double coverage = 0.0;
+	};
+
+	// both run on worker threads, possibly at the same time
+	struct GenerationCallbacks {
+		// every object as soon as it is placed
+		std::function<void(CreatedObject const&)> object;
+		std::function<void(GenerationProgress const&)> progress;
+	};
+
+	// handle to a generation running in the background, copies share it
+	class GenerationTask {
+	public:
+		struct State;
+
+		explicit GenerationTask(std::shared_ptr<State> state);
+
+		// stops placing objects as soon as possible, the ones placed so far are kept
+		void cancel();
+
+		// whether generation stopped, because it finished, was cancelled or ran out of time
+		bool done() const;
+
+		// objects placed since the last poll, for the game thread to pick up each frame
+		std::vector<CreatedObject> poll();
+
+		GenerationProgress progress() const;
+
+		// blocks until generation stops, then every object placed in the order create returns them
+		std::vector<CreatedObject> const& wait() const;
+
+	private:
+		std::shared_ptr<State> m_state;
+	};
 
 	class Generator {
 		class Impl;
@@ -18,5 +63,18 @@ namespace tulip::text {
 		static Generator* get();
 
 		std::vector<CreatedObject> create(std::u32string const& text, GeneratorConfig const& config);
+
+		// fills in the objects, placed objects and coverage of report
+		std::vector<CreatedObject> create(
+			std::u32string const& text, GeneratorConfig const& config, GenerationProgress& report
+		);
+
+		// generates on the worker pool and returns at once, generations run one at a time
+		// objects not placed by the deadline are left out
+		// glyphs are rasterized on a worker too, which the Sfml backend cannot do without a gl context
+		GenerationTask createAsync(
+			std::u32string text, std::shared_ptr<GeneratorConfig const> config, GenerationCallbacks callbacks = {},
+			std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt
+		);
 	};
-}
\ No newline at end of file
+}
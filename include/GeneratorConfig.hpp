@@ -3,12 +3,40 @@
 #include "ObjectKernel.hpp"
 
 #include <array>
+#include <chrono>
 #include <cstdint>
 #include <ghc/fs_fwd.hpp>
 #include <string>
 #include <mutex>
 
 namespace tulip::text {
+	enum class PlanningEffort {
+		Estimate,
+		Measure,
+		Patient,
+	};
+
+	enum class Precision {
+		Double,
+		Single,
+	};
+
+	enum class RasterBackend {
+		// glyphs and layout through sf::Font, needs a gl context
+		Sfml,
+		// glyphs rendered by freetype on the cpu, usable headless and from any thread
+		FreeType,
+	};
+
+	enum class LayoutMode {
+		// every unique glyph decomposed once and its objects copied to each occurrence
+		PerGlyph,
+		// the laid out text decomposed as one raster, in tiles
+		WholeString,
+		// whole string for texts of at least wholeStringLength glyphs that mostly appear once
+		Automatic,
+	};
+
 	struct GeneratorConfig {
 		mutable std::mutex mutex;
 
@@ -26,5 +54,55 @@ namespace tulip::text {
 		double minScore = 10.0f;
 		
 		double negativeScore = -1.0f;
+
+		// patch each kernel's correlation after a placement instead of recomputing it
+		bool incrementalScoring = true;
+		// bytes the correlation maps of all glyphs decomposed at once may take,
+		// glyphs that would go over are scored without them
+		size_t incrementalMemory = size_t(256) << 20;
+
+		// measured plans are slower to create but saved as wisdom for later sessions
+		PlanningEffort planningEffort = PlanningEffort::Estimate;
+
+		// single precision halves the memory traffic of the transforms, scores are only thresholded
+		Precision precision = Precision::Double;
+
+		// reuse the objects of glyphs decomposed before with the same font, kernels and scores,
+		// across sessions too when persisted to the save directory
+		bool cacheDecompositions = true;
+		bool persistDecompositions = false;
+
+		RasterBackend rasterBackend = RasterBackend::Sfml;
+
+		// above 1, every kernel is first ranked on the glyph downsampled by this factor and only the
+		// best pyramidCandidates are scored at full resolution, near their coarse peak
+		// more candidates or a smaller factor trade speed for placements closer to the full search
+		// replaces incremental scoring
+		int32_t pyramidFactor = 1;
+		int32_t pyramidCandidates = 16;
+
+		// placements taken from one scoring pass, the best kernel peaks that cover at most
+		// batchOverlap of their pixels twice, each rescored after the ones before it are placed
+		// cuts full passes per glyph, incremental scoring has none to cut and takes one at a time
+		int32_t placementBatch = 1;
+		double batchOverlap = 0.0;
+
+		LayoutMode layoutMode = LayoutMode::Automatic;
+		int32_t wholeStringLength = 16;
+		// side of the tiles a whole string raster is decomposed in, at least twice the largest kernel
+		int32_t layoutTileSize = 256;
+
+		// wall clock time one create may take, zero for no limit
+		// glyphs and tiles share it by the pixels they have left to cover, each keeps the objects
+		// placed when its share runs out, and only glyphs that finished in time are cached
+		// fft planning and kernel transforms are not interrupted, so a create at a new size can overrun
+		std::chrono::milliseconds timeBudget = std::chrono::milliseconds(0);
+
+		// after placement, replace clusters of a glyph's objects with one larger or rotated kernel and
+		// drop redundant ones, while the glyph left uncovered plus the background covered, weighted like
+		// scores, grows by at most objectTolerance of the glyph
+		// objects are then streamed once their glyph is optimized instead of as they are placed
+		bool optimizeObjects = false;
+		double objectTolerance = 0.01;
 	};
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "GeneratorConfig.hpp"
+#include "KernelBank.hpp"
 #include "MatrixOperations.hpp"
 
 #include <SFML/Graphics.hpp>
@@ -7,6 +9,14 @@
 #include <vector>
 
 namespace tulip::text {
+	// milliseconds spent in each stage of step, over every step so far
+	struct GeneratorStageTimes {
+		double edges = 0;
+		double field = 0;
+		double correlation = 0;
+		double selection = 0;
+		double placement = 0;
+	};
 
 	class GeneratorNew {
 		class Impl;
@@ -16,8 +26,19 @@ namespace tulip::text {
 		GeneratorNew();
 		~GeneratorNew();
 
-		void init(char32_t glyph);
+		// FreeType rasterizes glyphs and resamples kernel sprites on the cpu, no render target needed
+		void setRasterBackend(RasterBackend backend);
+
+		// false when the glyph could not be rasterized, the generator is then left with an empty glyph
+		bool init(char32_t glyph);
+        // with FreeType the sprite's sheet is read back once and kept while the sprites share it,
+        // so it must not be redrawn between calls
         void addKernel(sf::Sprite& kernel, double scale);
+        // the image drawn through transform into a 120 * scale square, always on the cpu
+        void addKernel(sf::Image const& image, sf::Transform const& transform, double scale);
+        // every kernel of the bank, in bank order
+        // the masks are read in place, so the bank has to outlive the generator and not be built on
+        void addKernels(KernelBank const& bank);
         void step(int steps = 1);
 
         sf::Image const& getGlyph() const;
@@ -26,5 +47,6 @@ namespace tulip::text {
         sf::Image const& getRemoved() const;
         sf::Image const& getKernel() const;
         sf::Image const& getKernel2(int index) const;
+        GeneratorStageTimes const& getTimes() const;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "CreatedObject.hpp"
+#include "DecompositionCache.hpp"
+#include "GeneratorConfig.hpp"
+#include "IntegralImage.hpp"
+#include "MatrixOperations.hpp"
+
+#include <oneapi/tbb/enumerable_thread_specific.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace tulip::text {
+	struct GlyphVector2D {
+		std::vector<double> data;
+		size_t width;
+		size_t height;
+		char32_t codepoint;
+		// set on the edges of a region cut from a larger raster that other regions continue past
+		ClippedEdges clipped = {};
+	};
+
+	// how a running generation reports what it placed and learns it should stop
+	// the default one reports nothing and never stops
+	struct GenerationControl {
+		std::atomic<bool> const* cancelled = nullptr;
+		std::optional<std::chrono::steady_clock::time_point> deadline;
+		std::function<void(CreatedObject const&)> object;
+		std::function<void(size_t finished, size_t total)> progress;
+		// set by the decomposition it was handed to when that stopped before finishing
+		mutable bool interrupted = false;
+
+		// next is how long the work about to start is expected to take
+		bool stopped(std::chrono::steady_clock::duration next = {}) const {
+			if (cancelled && cancelled->load(std::memory_order_relaxed)) {
+				return true;
+			}
+			return deadline && std::chrono::steady_clock::now() + next >= *deadline;
+		}
+
+		// a copy for one glyph or region that also stops at end
+		GenerationControl until(std::optional<std::chrono::steady_clock::time_point> end) const {
+			auto ret = *this;
+			ret.interrupted = false;
+			if (end && (!ret.deadline || *end < *ret.deadline)) {
+				ret.deadline = end;
+			}
+			return ret;
+		}
+	};
+
+	// called with every score as soon as it is placed
+	using PlacedCallback = std::function<void(ConvolutionScore const&)>;
+
+	template <class Real>
+	struct KernelSpectra {
+		KernelSpectrumBank<Real> bank;
+		Matrix<Real> scratch;
+		// one correlation workspace per worker, shared by every glyph padded to this size
+		oneapi::tbb::enumerable_thread_specific<BatchedCorrelation<Real>> workspaces;
+
+		KernelSpectra(size_t width, size_t height) :
+			bank(width, height),
+			scratch(width, height),
+			workspaces([this] {
+				return BatchedCorrelation<Real>(scratch, bank);
+			}) {}
+	};
+
+	// keyed by transform size and the factor the kernels were downsampled by
+	template <class Real>
+	using SpectraMap = std::map<std::tuple<size_t, size_t, size_t>, KernelSpectra<Real>>;
+
+	size_t countPositive(GlyphVector2D const& glyphVector);
+
+	// clears the pixels placed scores cover, as the decomposition does when placing them
+	void coverPixels(
+		GlyphVector2D& glyphVector, std::vector<ConvolutionScore> const& scores, GeneratorConfig const& config
+	);
+
+	// greedily places kernels on glyphs until none scores minScore, keeping the kernel spectra of
+	// every transform size it met, glyphs can be decomposed from several threads at once
+	class GlyphDecomposer {
+		std::mutex m_spectraMutex;
+		std::tuple<SpectraMap<double>, SpectraMap<float>> m_kernelSpectra;
+		// solid rectangular kernels are scored from an integral image instead of the fft
+		std::vector<std::optional<KernelRectangle>> m_rectangles;
+		// bytes of correlation maps held by glyphs being decomposed, capped by incrementalMemory
+		std::atomic<size_t> m_mapMemory = 0;
+		std::function<void(std::string const&)> m_log;
+
+		// message builds the text, only called when something listens
+		template <class Message>
+		void log(Message&& message) const;
+
+		template <class Real>
+		KernelSpectra<Real>& getKernelSpectra(
+			size_t width, size_t height, size_t level, GeneratorConfig const& config
+		);
+
+		template <class Real>
+		std::vector<ConvolutionScore> decomposeGlyph(
+			GlyphVector2D& glyphVector, GeneratorConfig const& config, size_t maxObjects,
+			GenerationControl const& control, PlacedCallback const& placed
+		);
+
+		static bool fitsGlyph(ObjectKernel const& kernel, GlyphVector2D const& glyphVector);
+
+		// calls fft(runBegin, runEnd) for every run of kernels without a rectangle
+		// and rectangle(id) for the others
+		template <class Fft, class Rectangle>
+		void splitKernels(size_t begin, size_t end, Fft&& fft, Rectangle&& rectangle) const;
+
+		// the peak of every kernel that fits the glyph
+		template <class Real>
+		std::vector<ConvolutionScore> getPeaks(
+			GlyphVector2D const& glyphVector, GeneratorConfig const& config, KernelSpectra<Real>& spectra,
+			BatchedCorrelation<Real> const& correlation, IntegralImage const& integral
+		);
+
+		// ranks every kernel on the glyph downsampled by level, then rescores only the best
+		// at full resolution in a window around their coarse peaks
+		template <class Real>
+		std::vector<ConvolutionScore> getPyramidPeaks(
+			GlyphVector2D const& glyphVector, GeneratorConfig const& config, size_t level,
+			KernelSpectra<Real>& spectra, BatchedCorrelation<Real> const& correlation
+		);
+
+		// up to size of the best peaks, each with at most batchOverlap of its pixels
+		// on the ones chosen before it, best first
+		static std::vector<ConvolutionScore> selectBatch(
+			std::vector<ConvolutionScore> peaks, GlyphVector2D const& glyphVector, GeneratorConfig const& config,
+			size_t size
+		);
+
+	public:
+		// drops the spectra of the previous kernels, every config decomposed with afterwards has to hold these
+		void setKernels(std::vector<ObjectKernel> const& kernels);
+
+		// where progress messages go, nowhere by default
+		void setLog(std::function<void(std::string const&)> log);
+
+		// places at most maxObjects objects, leaving what they did not cover in glyphVector
+		// stops early, with the objects placed so far, once control says so
+		std::vector<ConvolutionScore> decompose(
+			GlyphVector2D& glyphVector, GeneratorConfig const& config, size_t maxObjects,
+			GenerationControl const& control = {}, PlacedCallback const& placed = {}
+		);
+	};
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "CorrelationMaps.hpp"
+#include "MatrixOperations.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace tulip::text {
+	// the nonzero entries of a kernel when they fill an axis-aligned rectangle with one weight
+	struct KernelRectangle {
+		int32_t x;
+		int32_t y;
+		int32_t width;
+		int32_t height;
+		double weight;
+	};
+
+	std::optional<KernelRectangle> findRectangle(double const* kernel, size_t width, size_t height);
+
+	// summed-area table of a field that is background outside its bounds
+	// rectangular kernels score a placement with four lookups instead of a correlation
+	class IntegralImage {
+		size_t m_width;
+		size_t m_height;
+		double m_background;
+		std::vector<double> m_values;
+		// (width + 1) x (height + 1), entry (x, y) sums every value above and left of it
+		std::vector<double> m_sums;
+
+		void rebuild(size_t firstRow);
+
+	public:
+		IntegralImage(double const* values, size_t stride, size_t width, size_t height, double background);
+
+		// applies the deltas and rebuilds the rows from the topmost change down
+		void update(std::vector<PixelChange> const& changes);
+
+		double sum(int64_t x, int64_t y, int64_t width, int64_t height) const;
+
+		// same layout and peak rule as BatchedCorrelation: entry (x, y) is the placement at
+		// (x - kernelWidth + 1, y - kernelHeight + 1)
+		CorrelationPeak peak(
+			KernelRectangle const& rectangle, size_t kernelWidth, size_t kernelHeight, double tolerance,
+			ClippedEdges clipped = {}
+		) const;
+
+		// rewrites the map entries in [left, right) x [top, bottom)
+		void correlate(
+			KernelRectangle const& rectangle, size_t kernelWidth, size_t kernelHeight, Matrix<double>& map,
+			size_t left, size_t top, size_t right, size_t bottom
+		) const;
+
+		void correlate(
+			KernelRectangle const& rectangle, size_t kernelWidth, size_t kernelHeight, Matrix<double>& map
+		) const {
+			this->correlate(rectangle, kernelWidth, kernelHeight, map, 0, 0, map.width, map.height);
+		}
+	};
+}
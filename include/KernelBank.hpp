@@ -0,0 +1,114 @@
+#pragma once
+
+#include "MappedFile.hpp"
+#include "ObjectKernel.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <ghc/fs_fwd.hpp>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace tulip::text {
+	// every scale and rotation of one object, both ranges inclusive
+	// a step of zero or less only takes the minimum
+	struct KernelSweep {
+		int32_t objectId;
+		double minScale;
+		double maxScale;
+		double scaleStep;
+		double minRotation;
+		double maxRotation;
+		double rotationStep;
+	};
+
+	// a kernel mask in the bank, cropped to its set pixels
+	struct BankKernel {
+		int32_t objectId;
+		double scale;
+		// degrees clockwise, like sf::Transformable::setRotation
+		double rotation;
+		size_t offset;
+		int32_t width;
+		int32_t height;
+		// the sprite centre in mask pixels
+		double centerX;
+		double centerY;
+		size_t count;
+	};
+
+	// kernels resampled from object sprites on the cpu, deduplicated, masks back to back in one arena
+	// a sprite pixel becomes 2 * scale mask pixels, as kernelFromObject renders them
+	class KernelBank {
+		struct Source {
+			size_t width;
+			size_t height;
+			std::vector<uint8_t> rgba;
+		};
+
+		std::map<int32_t, Source> m_sources;
+		std::vector<uint8_t> m_arena;
+		// a loaded bank reads its masks straight from the file until it is built on
+		std::shared_ptr<MappedFile> m_mapping;
+		uint8_t const* m_mappedMasks = nullptr;
+		std::vector<BankKernel> m_kernels;
+		// kernels of each width and height, only those can be duplicates of each other
+		std::map<std::pair<int32_t, int32_t>, std::vector<size_t>> m_sizes;
+		double m_threshold = 0.7;
+		double m_tolerance = 0.0;
+
+		uint8_t const* masks() const {
+			return m_mapping ? m_mappedMasks : m_arena.data();
+		}
+
+		size_t maskBytes() const;
+
+		bool isDuplicate(std::vector<uint8_t> const& mask, int32_t width, int32_t height, size_t count) const;
+
+	public:
+		// rgba pixels of the object's sprite frame, row-major without padding
+		void setSource(int32_t objectId, uint8_t const* rgba, size_t width, size_t height);
+
+		// luminance times alpha a pixel needs to be set
+		void setThreshold(double threshold);
+
+		// fraction of differing pixels up to which two masks of one size count as the same kernel
+		void setTolerance(double tolerance);
+
+		// adds every kernel of the sweeps that is not already in the bank, in sweep order
+		// returns how many were added, objects without a source are skipped
+		size_t build(std::vector<KernelSweep> const& sweeps);
+
+		size_t size() const {
+			return m_kernels.size();
+		}
+
+		BankKernel const& operator[](size_t index) const {
+			return m_kernels[index];
+		}
+
+		// row-major width x height, 1 where set
+		uint8_t const* mask(size_t index) const {
+			return this->masks() + m_kernels[index].offset;
+		}
+
+		// weight on every set pixel, offsets in the units create places objects in
+		// a copy, Generator still scores ObjectKernel weights, GeneratorNew reads mask() in place
+		ObjectKernel objectKernel(size_t index, double weight) const;
+
+		// identifies what a build from sweeps would produce: the sources, the settings and the sweeps
+		// changing a sprite sheet changes it and so invalidates saved banks
+		uint64_t fingerprint(std::vector<KernelSweep> const& sweeps) const;
+
+		// header, per kernel metadata and the mask arena as one file
+		bool save(ghc::filesystem::path const& path, uint64_t fingerprint) const;
+
+		// replaces the kernels with the file's if it was saved with fingerprint and is intact
+		// the masks stay in the mapped file, nothing is copied
+		bool load(ghc::filesystem::path const& path, uint64_t fingerprint);
+
+		void clear();
+	};
+}
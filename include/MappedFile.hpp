@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ghc/fs_fwd.hpp>
+
+namespace tulip::text {
+	// read-only view of a whole file, mapped rather than read so large files cost nothing until touched
+	class MappedFile {
+		uint8_t const* m_data = nullptr;
+		size_t m_size = 0;
+#ifdef _WIN32
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+#else
+		int m_file = -1;
+#endif
+
+	public:
+		// invalid if the file can not be opened or is empty
+		explicit MappedFile(ghc::filesystem::path const& path);
+		~MappedFile();
+
+		MappedFile(MappedFile const&) = delete;
+		MappedFile& operator=(MappedFile const&) = delete;
+
+		bool valid() const {
+			return m_data != nullptr;
+		}
+
+		uint8_t const* data() const {
+			return m_data;
+		}
+
+		size_t size() const {
+			return m_size;
+		}
+	};
+}
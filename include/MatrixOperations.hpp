@@ -1,11 +1,47 @@
 #pragma once
 
+#include <cstdint>
 #include <fftw3.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace tulip::text {
 
+    // fftw types for each precision, double runs on fftw and float on fftwf
+    template <class Real>
+    struct FFTW;
+
+    template <>
+    struct FFTW<double> {
+        using Complex = fftw_complex;
+        using Plan = fftw_plan;
+    };
+
+    template <>
+    struct FFTW<float> {
+        using Complex = fftwf_complex;
+        using Plan = fftwf_plan;
+    };
+
+    template <class Real>
+    using Complex = typename FFTW<Real>::Complex;
+
+    template <class Real>
+    using PlanHandle = typename FFTW<Real>::Plan;
+
+    // out = a * b elementwise, vectorized with avx2 or sse2 when the cpu has them
+    // out may alias a or b
+    void multiplySpectra(fftw_complex const* a, fftw_complex const* b, fftw_complex* out, size_t count);
+    void multiplySpectra(fftwf_complex const* a, fftwf_complex const* b, fftwf_complex* out, size_t count);
+
+    // smallest size >= minimum with no prime factors above 7, which fftw transforms fastest
+    size_t fftSize(size_t minimum);
+
     template <class Type>
-	struct Matrix {
+    struct Matrix {
         size_t width;
         size_t height;
         Type* data;
@@ -14,33 +50,190 @@ namespace tulip::text {
             return data[y * width + x];
         }
 
+        Type const& operator()(size_t x, size_t y) const {
+            return data[y * width + x];
+        }
+
         void fill(Type value);
         void zero();
 
         Matrix(size_t width, size_t height);
         ~Matrix();
+
+        Matrix(Matrix const&) = delete;
+        Matrix& operator=(Matrix const&) = delete;
+
+        Matrix(Matrix&& other) noexcept :
+            width(other.width),
+            height(other.height),
+            data(std::exchange(other.data, nullptr)) {}
     };
 
+    template <class Real>
     struct Plan {
-        fftw_plan plan;
+        PlanHandle<Real> plan;
 
-        Plan(fftw_plan plan);
+        Plan(PlanHandle<Real> plan);
         ~Plan();
+
+        Plan(Plan const&) = delete;
+        Plan& operator=(Plan const&) = delete;
+
+        Plan(Plan&& other) noexcept : plan(std::exchange(other.plan, nullptr)) {}
+    };
+
+    // process-wide cache of fftw plans, keyed by shape rather than by buffer
+    // plans are executed through the new-array interface, so every matrix of a shape shares one
+    // each precision has its own planner, cache and wisdom
+    template <class Real>
+    class PlanCache {
+        struct Key {
+            bool forward;
+            size_t width;
+            size_t height;
+            size_t count;
+            bool inPlace;
+            bool aligned;
+            unsigned flags = 0;
+
+            auto operator<=>(Key const&) const = default;
+        };
+
+        // the fftw planner is not thread safe, only executing plans is
+        std::mutex m_mutex;
+        std::map<Key, Plan<Real>> m_plans;
+        unsigned m_flags = FFTW_ESTIMATE;
+        bool m_wisdomChanged = false;
+
+        PlanHandle<Real> find(Key key);
+
+    public:
+        static PlanCache& get();
+
+        // FFTW_ESTIMATE, FFTW_MEASURE or FFTW_PATIENT for plans created from now on
+        void setFlags(unsigned flags);
+
+        // count width x height real matrices stored back to back, to or from their half spectra
+        PlanHandle<Real> forward(size_t width, size_t height, size_t count, Real* input, Complex<Real>* output);
+        PlanHandle<Real> backward(size_t width, size_t height, size_t count, Complex<Real>* input, Real* output);
+
+        bool loadWisdom(std::string const& path);
+        // only writes when a measured plan was added since the last load or save
+        bool saveWisdom(std::string const& path);
+    };
+
+    // half spectra of a kernel set, padded to one matrix size and scaled by 1 / (width * height)
+    // kernels are stored flipped so multiplying with an input spectrum correlates
+    // output (x, y) then scores the kernel placed at (x - width + 1, y - height + 1)
+    template <class Real>
+    struct KernelSpectrumBank {
+        size_t width;
+        size_t height;
+        std::vector<Matrix<Complex<Real>>> spectra;
+        std::vector<std::pair<size_t, size_t>> extents;
+
+        KernelSpectrumBank(size_t width, size_t height);
+
+        size_t add(double const* kernel, size_t kernelWidth, size_t kernelHeight);
+
+        size_t size() const {
+            return spectra.size();
+        }
+
+        Matrix<Complex<Real>> const& operator[](size_t index) const {
+            return spectra[index];
+        }
+
+    private:
+        Matrix<Real> m_staging;
+        Matrix<Complex<Real>> m_result;
+        PlanHandle<Real> m_plan;
     };
 
+    template <class Real>
     struct Convolution {
-        Matrix<double>& input;
-        Matrix<double>& kernel;
-        Matrix<double>& output;
-        Matrix<fftw_complex> inputResult;
-        Matrix<fftw_complex> kernelResult;
-        Plan kernelPlan;
-        Plan inputPlan;
-        Plan outputPlan;
-
-        Convolution(Matrix<double>& input, Matrix<double>& kernel, Matrix<double>& output);
+        Matrix<Real>& input;
+        Matrix<Real>& kernel;
+        Matrix<Real>& output;
+        Matrix<Complex<Real>> inputResult;
+        Matrix<Complex<Real>> kernelResult;
+        PlanHandle<Real> kernelPlan;
+        PlanHandle<Real> inputPlan;
+        PlanHandle<Real> outputPlan;
+
+        Convolution(Matrix<Real>& input, Matrix<Real>& kernel, Matrix<Real>& output);
         ~Convolution();
 
         void execute();
+        void execute(Matrix<Complex<Real>> const& kernelSpectrum);
+    };
+
+    struct CorrelationPeak {
+        double score = 0.0;
+        int32_t x = 0;
+        int32_t y = 0;
+    };
+
+    // edges of an input that placements have to stay inside of instead of hanging over,
+    // for inputs cut from a larger one that continues past them
+    struct ClippedEdges {
+        bool left = false;
+        bool top = false;
+        bool right = false;
+        bool bottom = false;
+    };
+
+    // scans a width x height correlation map row by row, entry (x, y) scoring the placement at
+    // (x - kernelWidth + 1, y - kernelHeight + 1)
+    // a later position only wins if it beats the current peak by more than tolerance
+    // placements crossing a clipped edge are skipped
+    template <class Real>
+    CorrelationPeak findPeak(
+        Real const* map, size_t stride, size_t width, size_t height, size_t kernelWidth,
+        size_t kernelHeight, double tolerance, ClippedEdges clipped = {}
+    );
+
+    // correlates one input against every kernel of a bank
+    // the input is transformed once, the inverse transforms run batchSize kernels at a time
+    template <class Real>
+    struct BatchedCorrelation {
+        Matrix<Real>& input;
+        KernelSpectrumBank<Real> const& bank;
+        size_t batchSize;
+        Matrix<Complex<Real>> inputResult;
+        Matrix<Complex<Real>> products;
+        Matrix<Real> outputs;
+        PlanHandle<Real> inputPlan;
+
+        BatchedCorrelation(Matrix<Real>& input, KernelSpectrumBank<Real> const& bank, size_t batchSize = 16);
+
+        void transform();
+
+        // peaks are searched over every placement overlapping the inputWidth x inputHeight region
+        // and not crossing its clipped edges
+        // a later position only wins if it beats the current peak by more than tolerance
+        void correlate(
+            Matrix<Complex<Real>> const& inputSpectrum, size_t begin, size_t end, size_t inputWidth,
+            size_t inputHeight, double tolerance, CorrelationPeak* peaks, ClippedEdges clipped = {}
+        );
+
+        // copies the full correlation of each kernel into maps sized
+        // (inputWidth + kernelWidth - 1) x (inputHeight + kernelHeight - 1)
+        // the maps stay double so incremental patches accumulate at full precision
+        void correlate(
+            Matrix<Complex<Real>> const& inputSpectrum, size_t begin, size_t end, Matrix<double>* maps
+        );
+
+        std::vector<CorrelationPeak> execute(size_t inputWidth, size_t inputHeight, double tolerance);
+
+    private:
+        std::map<size_t, PlanHandle<Real>> m_outputPlans;
+
+        PlanHandle<Real> outputPlan(size_t count);
+
+        template <class Callback>
+        void correlateBatches(
+            Matrix<Complex<Real>> const& inputSpectrum, size_t begin, size_t end, Callback&& callback
+        );
     };
-}
\ No newline at end of file
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
 namespace tulip::text {
 	struct ObjectKernel {
 		std::vector<double> data;
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "DecompositionCache.hpp"
+#include "ObjectKernel.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+namespace tulip::text {
+	// shrinks a greedy decomposition after the fact, replacing clusters of placements with one larger
+	// or rotated kernel and dropping placements the others make redundant
+	// every change is charged the glyph pixels it leaves uncovered plus the background pixels it covers,
+	// less what it covers or frees, and the charges together stay within a budget
+	class ObjectReducer {
+		struct Footprint {
+			// set pixels as x, y and weight
+			std::vector<std::tuple<int32_t, int32_t, double>> pixels;
+			int32_t left = 0;
+			int32_t top = 0;
+			int32_t right = 0;
+			int32_t bottom = 0;
+		};
+
+		std::vector<Footprint> m_footprints;
+		int32_t m_padding = 0;
+
+		class Reduction;
+
+	public:
+		explicit ObjectReducer(std::vector<ObjectKernel> const& kernels);
+
+		// values is the glyph before any placement, background everywhere outside it
+		// budget is a fraction of the glyph's positive pixels, new placements must still score minScore
+		std::vector<ConvolutionScore> reduce(
+			double const* values, size_t width, size_t height, double background,
+			std::vector<ConvolutionScore> const& scores, double budget, double minScore
+		) const;
+	};
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "CorrelationMaps.hpp"
+
+#include <optional>
+#include <queue>
+#include <vector>
+
+namespace tulip::text {
+	struct PlacementCandidate {
+		double score = 0.0;
+		int32_t x = 0;
+		int32_t y = 0;
+		size_t kernel = 0;
+	};
+
+	// lazy greedy selection over the peaks of a set of correlation maps
+	// while placements only remove input no map entry grows, so a kernel's highest entry bounds
+	// every peak it reports later, even where the tolerance rule moves the peak elsewhere
+	// kernels whose map a placement touched are queued by that bound and only rescanned once they
+	// reach the top of the queue
+	class PlacementEngine {
+		struct Entry {
+			// the peak score of a fresh kernel, the bound of a stale one
+			double key;
+			size_t kernel;
+			// entries queued before the kernel's latest are skipped
+			size_t version;
+
+			// higher score first, ties to the later kernel like the full greedy scan
+			bool operator<(Entry const& other) const {
+				if (key != other.key) {
+					return key < other.key;
+				}
+				return kernel < other.kernel;
+			}
+		};
+
+		CorrelationMaps const& m_maps;
+		double m_tolerance;
+		std::vector<bool> m_active;
+		std::vector<bool> m_stale;
+		std::vector<PlacementCandidate> m_peaks;
+		std::vector<double> m_bounds;
+		std::vector<size_t> m_versions;
+		std::priority_queue<Entry> m_queue;
+		size_t m_evaluations = 0;
+
+		Entry evaluate(size_t kernel);
+		void rebuild();
+
+	public:
+		PlacementEngine(CorrelationMaps const& maps, std::vector<bool> active, double tolerance);
+
+		// best placement, or nothing once the best one scores below minScore
+		std::optional<PlacementCandidate> next(double minScore);
+
+		// call after the maps were updated with the changes of a placement
+		void invalidate(std::vector<PixelChange> const& changes);
+
+		size_t evaluations() const {
+			return m_evaluations;
+		}
+	};
+}
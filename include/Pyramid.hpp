@@ -0,0 +1,27 @@
+#pragma once
+
+#include "MatrixOperations.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace tulip::text {
+	// side of a level downsampled by factor, partial blocks included
+	inline size_t downsampledSize(size_t size, size_t factor) {
+		return (size + factor - 1) / factor;
+	}
+
+	// mean of every factor x factor block, pixels past the edge count as background
+	std::vector<double> downsample(
+		double const* values, size_t width, size_t height, size_t factor, double background
+	);
+
+	// best placement of a kernel with its top left corner in [left, right] x [top, bottom],
+	// scored directly against a field that is background outside its bounds
+	// same peak rule as findPeak, so it agrees with the full correlation over the window
+	CorrelationPeak refinePeak(
+		double const* field, size_t width, size_t height, double background, double const* kernel,
+		size_t kernelWidth, size_t kernelHeight, int32_t left, int32_t top, int32_t right, int32_t bottom,
+		double tolerance
+	);
+}
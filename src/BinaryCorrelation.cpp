@@ -0,0 +1,143 @@
+#include <BinaryCorrelation.hpp>
+#include <bit>
+#include <cmath>
+
+#if (defined(__x86_64__) || defined(_M_X64)) && !defined(_MSC_VER)
+#define TEXT_OBJECT_POPCNT_DISPATCH 1
+#define TEXT_OBJECT_TARGET_POPCNT __attribute__((target("popcnt")))
+#endif
+
+// the body has to be compiled into each target clone, a call would drop back to the generic build
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TEXT_OBJECT_ALWAYS_INLINE __forceinline
+#else
+#define TEXT_OBJECT_ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
+
+using namespace tulip::text;
+
+namespace {
+	using CountFunction = void (*)(BitMatrix const&, BitMatrix const&, int64_t, uint32_t*);
+
+	// set pixels shared by the kernel and the plane for every placement whose top row is top
+	TEXT_OBJECT_ALWAYS_INLINE void countRowImpl(BitMatrix const& plane, BitMatrix const& kernel, int64_t top, uint32_t* counts) {
+		auto const mapWidth = plane.width() + kernel.width() - 1;
+		auto const left = 1 - int64_t(kernel.width());
+		std::fill(counts, counts + mapWidth, 0);
+
+		for (size_t kernelY = 0; kernelY < kernel.height(); ++kernelY) {
+			auto const y = top + int64_t(kernelY);
+			if (y < 0 || y >= int64_t(plane.height())) {
+				continue;
+			}
+
+			auto const kernelRow = kernel.row(kernelY);
+			for (size_t x = 0; x < mapWidth; ++x) {
+				uint32_t count = 0;
+				for (size_t word = 0; word < kernel.stride(); ++word) {
+					auto const bits = plane.bits(y, left + int64_t(x) + int64_t(word) * 64);
+					count += std::popcount(kernelRow[word] & bits);
+				}
+				counts[x] += count;
+			}
+		}
+	}
+
+	void countRowGeneric(BitMatrix const& plane, BitMatrix const& kernel, int64_t top, uint32_t* counts) {
+		countRowImpl(plane, kernel, top, counts);
+	}
+
+#if defined(TEXT_OBJECT_POPCNT_DISPATCH)
+	// without -mpopcnt the generic build counts bits in software
+	TEXT_OBJECT_TARGET_POPCNT
+	void countRowPopcnt(BitMatrix const& plane, BitMatrix const& kernel, int64_t top, uint32_t* counts) {
+		countRowImpl(plane, kernel, top, counts);
+	}
+#endif
+
+	CountFunction selectCount() {
+#if defined(TEXT_OBJECT_POPCNT_DISPATCH)
+		if (__builtin_cpu_supports("popcnt")) {
+			return &countRowPopcnt;
+		}
+#endif
+		return &countRowGeneric;
+	}
+
+	void countRow(BitMatrix const& plane, BitMatrix const& kernel, int64_t top, uint32_t* counts) {
+		static auto const s_count = selectCount();
+		s_count(plane, kernel, top, counts);
+	}
+
+	// calls callback(y, scores) for every row of the correlation map
+	template <class Callback>
+	void scoreRows(BinaryField const& field, BitMatrix const& kernel, double weight, Callback&& callback) {
+		auto const mapWidth = field.width + kernel.width() - 1;
+		auto const mapHeight = field.height + kernel.height() - 1;
+		auto const base = field.background * double(kernel.count());
+
+		std::vector<uint32_t> counts(mapWidth);
+		std::vector<double> scores(mapWidth);
+
+		for (size_t y = 0; y < mapHeight; ++y) {
+			auto const top = int64_t(y) + 1 - int64_t(kernel.height());
+			std::fill(scores.begin(), scores.end(), base);
+
+			// planes add their weight on top of the background
+			for (size_t plane = 0; plane < field.planes.size(); ++plane) {
+				countRow(field.planes[plane], kernel, top, counts.data());
+				for (size_t x = 0; x < mapWidth; ++x) {
+					scores[x] += field.weights[plane] * counts[x];
+				}
+			}
+
+			for (auto& score : scores) {
+				score *= weight;
+			}
+			callback(y, scores.data());
+		}
+	}
+}
+
+BitMatrix BitMatrix::fromValues(double const* values, size_t width, size_t height) {
+	BitMatrix ret(width, height);
+	for (size_t y = 0; y < height; ++y) {
+		for (size_t x = 0; x < width; ++x) {
+			if (values[y * width + x] != 0.0) {
+				ret.set(x, y);
+			}
+		}
+	}
+	return ret;
+}
+
+size_t BitMatrix::count() const {
+	size_t ret = 0;
+	for (auto word : m_words) {
+		ret += std::popcount(word);
+	}
+	return ret;
+}
+
+bool tulip::text::prefersDirect(
+	BinaryField const& field, size_t kernelWidth, size_t kernelHeight, size_t fftWidth, size_t fftHeight
+) {
+	// a word costs about four instructions with the unaligned extract,
+	// a real inverse transform about 2.5 n log2 n flops plus the spectrum product
+	auto const placements = double(field.width + kernelWidth - 1) * double(field.height + kernelHeight - 1);
+	auto const words = double(field.planes.size() * kernelHeight * ((kernelWidth + 63) / 64));
+	auto const direct = 4.0 * words * placements;
+
+	auto const n = double(fftWidth * fftHeight);
+	auto const fft = 2.5 * n * std::log2(n) + 3.0 * n;
+
+	return direct < fft;
+}
+
+void tulip::text::correlateDirect(
+	BinaryField const& field, BitMatrix const& kernel, double weight, Matrix<double>& map
+) {
+	scoreRows(field, kernel, weight, [&](size_t y, double const* scores) {
+		std::copy(scores, scores + map.width, map.data + y * map.width);
+	});
+}
@@ -0,0 +1,98 @@
+#include <CorrelationMaps.hpp>
+#include <algorithm>
+
+using namespace tulip::text;
+
+CorrelationMaps::CorrelationMaps(
+	std::vector<ObjectKernel> const& kernels, std::vector<bool> const& active, size_t inputWidth,
+	size_t inputHeight, ClippedEdges clipped
+) :
+	m_clipped(clipped) {
+	m_maps.reserve(kernels.size());
+	m_taps.reserve(kernels.size());
+
+	for (size_t id = 0; id < kernels.size(); ++id) {
+		auto const& kernel = kernels[id];
+		size_t width = kernel.width;
+		size_t height = kernel.height;
+		m_extents.emplace_back(width, height);
+
+		auto& taps = m_taps.emplace_back();
+		bool nonNegative = true;
+		if (!active[id]) {
+			m_maps.emplace_back(0, 0);
+			m_nonNegative.push_back(nonNegative);
+			continue;
+		}
+
+		m_maps.emplace_back(inputWidth + width - 1, inputHeight + height - 1);
+
+		// only the nonzero entries contribute to an update
+		for (size_t y = 0; y < height; ++y) {
+			for (size_t x = 0; x < width; ++x) {
+				auto weight = kernel.data[y * width + x];
+				if (weight != 0.0) {
+					taps.push_back({ int32_t(x), int32_t(y), weight });
+					nonNegative = nonNegative && weight > 0.0;
+				}
+			}
+		}
+		m_nonNegative.push_back(nonNegative);
+		m_totalTaps += taps.size();
+	}
+}
+
+size_t CorrelationMaps::memory(
+	std::vector<ObjectKernel> const& kernels, std::vector<bool> const& active, size_t inputWidth,
+	size_t inputHeight
+) {
+	size_t ret = 0;
+	for (size_t id = 0; id < kernels.size(); ++id) {
+		if (active[id]) {
+			ret += (inputWidth + kernels[id].width - 1) * (inputHeight + kernels[id].height - 1) * sizeof(double);
+		}
+	}
+	return ret;
+}
+
+void CorrelationMaps::update(size_t kernel, std::vector<PixelChange> const& changes) {
+	auto& map = m_maps[kernel];
+	auto [width, height] = m_extents[kernel];
+
+	// the placement at (px, py) sees input (x, y) through tap (x - px, y - py)
+	// and is stored at (px + width - 1, py + height - 1)
+	for (auto const& change : changes) {
+		auto baseX = change.x + int32_t(width) - 1;
+		auto baseY = change.y + int32_t(height) - 1;
+
+		for (auto const& tap : m_taps[kernel]) {
+			map(baseX - tap.x, baseY - tap.y) += change.delta * tap.weight;
+		}
+	}
+}
+
+CorrelationPeak CorrelationMaps::peak(size_t kernel, double tolerance, double& maximum) const {
+	auto const& map = m_maps[kernel];
+	auto [width, height] = m_extents[kernel];
+
+	// findPeak's scan, tracking the maximum on the way
+	CorrelationPeak peak;
+	maximum = 0.0;
+	auto const left = m_clipped.left ? width - 1 : 0;
+	auto const top = m_clipped.top ? height - 1 : 0;
+	auto const right = m_clipped.right ? map.width - width + 1 : map.width;
+	auto const bottom = m_clipped.bottom ? map.height - height + 1 : map.height;
+	for (size_t y = top; y < bottom; ++y) {
+		for (size_t x = left; x < right; ++x) {
+			auto score = map(x, y);
+			maximum = std::max(maximum, score);
+
+			if (score > peak.score + tolerance) {
+				peak.score = score;
+				peak.x = int32_t(x) - int32_t(width) + 1;
+				peak.y = int32_t(y) - int32_t(height) + 1;
+			}
+		}
+	}
+	return peak;
+}
@@ -0,0 +1,236 @@
+#include <DecompositionCache.hpp>
+#include <ghc/filesystem.hpp>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+
+using namespace tulip::text;
+
+namespace {
+	constexpr uint64_t s_fnvOffset = 0xcbf29ce484222325;
+	constexpr uint64_t s_fnvPrime = 0x100000001b3;
+	// bump when the file layout changes
+	constexpr uint32_t s_fileVersion = 1;
+	constexpr char s_fileMagic[4] = { 'T', 'O', 'D', 'C' };
+
+	void hashBytes(uint64_t& hash, void const* data, size_t size) {
+		auto bytes = static_cast<unsigned char const*>(data);
+		for (size_t i = 0; i < size; ++i) {
+			hash = (hash ^ bytes[i]) * s_fnvPrime;
+		}
+	}
+
+	// raw native layout, the files are only read back on the machine that wrote them
+	template <class Type>
+	void write(std::ostream& stream, Type value) {
+		stream.write(reinterpret_cast<char const*>(&value), sizeof(value));
+	}
+
+	template <class Type>
+	bool read(std::istream& stream, Type& value) {
+		return bool(stream.read(reinterpret_cast<char*>(&value), sizeof(value)));
+	}
+
+	void writeKey(std::ostream& stream, DecompositionKey const& key) {
+		write(stream, key.fontHash);
+		write(stream, key.fontSize);
+		write(stream, uint32_t(key.codepoint));
+		write(stream, key.kernelHash);
+		write(stream, key.minScore);
+		write(stream, key.negativeScore);
+		write(stream, key.objectsPerGlyph);
+		write(stream, key.precision);
+		write(stream, key.rasterBackend);
+		write(stream, key.pyramidFactor);
+		write(stream, key.pyramidCandidates);
+		write(stream, uint8_t(key.incrementalScoring));
+		write(stream, key.placementBatch);
+		write(stream, key.batchOverlap);
+		write(stream, key.objectTolerance);
+	}
+
+	bool readKey(std::istream& stream, DecompositionKey& key) {
+		uint32_t codepoint = 0;
+		uint8_t incrementalScoring = 0;
+		bool ok = read(stream, key.fontHash) && read(stream, key.fontSize) && read(stream, codepoint) &&
+			read(stream, key.kernelHash) && read(stream, key.minScore) && read(stream, key.negativeScore) &&
+			read(stream, key.objectsPerGlyph) && read(stream, key.precision) &&
+			read(stream, key.rasterBackend) &&
+			read(stream, key.pyramidFactor) && read(stream, key.pyramidCandidates) &&
+			read(stream, incrementalScoring) && read(stream, key.placementBatch) && read(stream, key.batchOverlap) &&
+			read(stream, key.objectTolerance);
+		key.codepoint = codepoint;
+		key.incrementalScoring = incrementalScoring != 0;
+		return ok;
+	}
+}
+
+uint64_t DecompositionKey::hash() const {
+	auto hash = s_fnvOffset;
+	auto add = [&](auto value) {
+		hashBytes(hash, &value, sizeof(value));
+	};
+
+	add(fontHash);
+	add(fontSize);
+	add(uint32_t(codepoint));
+	add(kernelHash);
+	add(minScore);
+	add(negativeScore);
+	add(objectsPerGlyph);
+	add(precision);
+	add(rasterBackend);
+	add(pyramidFactor);
+	add(pyramidCandidates);
+	add(uint8_t(incrementalScoring));
+	add(placementBatch);
+	add(batchOverlap);
+	add(objectTolerance);
+	return hash;
+}
+
+DecompositionCache::DecompositionCache(size_t capacity) : m_capacity(capacity) {}
+
+void DecompositionCache::setDirectory(std::optional<ghc::filesystem::path> directory) {
+	std::lock_guard lock(m_mutex);
+	m_directory = std::move(directory);
+}
+
+void DecompositionCache::remember(DecompositionKey const& key, std::vector<ConvolutionScore> scores) {
+	auto it = m_index.find(key);
+	if (it != m_index.end()) {
+		it->second->second = std::move(scores);
+		m_entries.splice(m_entries.begin(), m_entries, it->second);
+		return;
+	}
+
+	m_entries.emplace_front(key, std::move(scores));
+	m_index.emplace(key, m_entries.begin());
+
+	while (m_entries.size() > m_capacity) {
+		m_index.erase(m_entries.back().first);
+		m_entries.pop_back();
+	}
+}
+
+std::optional<std::vector<ConvolutionScore>> DecompositionCache::find(DecompositionKey const& key) {
+	std::lock_guard lock(m_mutex);
+
+	auto it = m_index.find(key);
+	if (it != m_index.end()) {
+		m_entries.splice(m_entries.begin(), m_entries, it->second);
+		return it->second->second;
+	}
+
+	auto scores = this->load(key);
+	if (scores) {
+		this->remember(key, *scores);
+	}
+	return scores;
+}
+
+void DecompositionCache::insert(DecompositionKey const& key, std::vector<ConvolutionScore> scores) {
+	std::lock_guard lock(m_mutex);
+
+	this->save(key, scores);
+	this->remember(key, std::move(scores));
+}
+
+void DecompositionCache::clear() {
+	std::lock_guard lock(m_mutex);
+	m_entries.clear();
+	m_index.clear();
+}
+
+std::optional<std::vector<ConvolutionScore>> DecompositionCache::load(DecompositionKey const& key) const {
+	if (!m_directory) {
+		return std::nullopt;
+	}
+
+	std::ifstream stream(*m_directory / (std::to_string(key.hash()) + ".bin"), std::ios::binary);
+	if (!stream) {
+		return std::nullopt;
+	}
+
+	std::array<char, 4> magic;
+	uint32_t version = 0;
+	DecompositionKey stored;
+	uint64_t count = 0;
+	if (!stream.read(magic.data(), magic.size()) || std::memcmp(magic.data(), s_fileMagic, magic.size()) != 0 ||
+		!read(stream, version) || version != s_fileVersion || !readKey(stream, stored) || stored != key ||
+		!read(stream, count)) {
+		return std::nullopt;
+	}
+
+	// a glyph never gets more than objectsPerGlyph, and a truncated file must not size the vector
+	auto const dataStart = stream.tellg();
+	stream.seekg(0, std::ios::end);
+	auto const dataEnd = stream.tellg();
+	stream.seekg(dataStart);
+	constexpr auto scoreSize = sizeof(double) + 2 * sizeof(int32_t) + sizeof(uint64_t);
+	if (!stream || dataStart < 0 || count > uint64_t(std::max(key.objectsPerGlyph, 0)) ||
+		count > uint64_t(dataEnd - dataStart) / scoreSize) {
+		return std::nullopt;
+	}
+
+	std::vector<ConvolutionScore> scores(count);
+	for (auto& score : scores) {
+		uint64_t kernelId = 0;
+		if (!read(stream, score.score) || !read(stream, score.x) || !read(stream, score.y) ||
+			!read(stream, kernelId)) {
+			return std::nullopt;
+		}
+		score.kernelId = kernelId;
+	}
+	return scores;
+}
+
+void DecompositionCache::save(DecompositionKey const& key, std::vector<ConvolutionScore> const& scores) const {
+	if (!m_directory) {
+		return;
+	}
+
+	std::error_code error;
+	ghc::filesystem::create_directories(*m_directory, error);
+
+	// written next to the target and renamed, so readers never see half a file
+	auto path = *m_directory / (std::to_string(key.hash()) + ".bin");
+	auto temporary = path;
+	temporary += ".tmp";
+	{
+		std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+		if (!stream) {
+			return;
+		}
+
+		stream.write(s_fileMagic, sizeof(s_fileMagic));
+		write(stream, s_fileVersion);
+		writeKey(stream, key);
+		write(stream, uint64_t(scores.size()));
+		for (auto const& score : scores) {
+			write(stream, score.score);
+			write(stream, score.x);
+			write(stream, score.y);
+			write(stream, uint64_t(score.kernelId));
+		}
+		if (!stream) {
+			return;
+		}
+	}
+	ghc::filesystem::rename(temporary, path, error);
+}
+
+uint64_t DecompositionCache::hashFile(ghc::filesystem::path const& path) {
+	std::ifstream stream(path, std::ios::binary);
+	if (!stream) {
+		return 0;
+	}
+
+	auto hash = s_fnvOffset;
+	std::array<char, 1 << 16> buffer;
+	while (stream.read(buffer.data(), buffer.size()) || stream.gcount() > 0) {
+		hashBytes(hash, buffer.data(), size_t(stream.gcount()));
+	}
+	return hash;
+}
@@ -13,50 +13,37 @@ int main() {
     window.create(sf::VideoMode(800, 800), "My window");
 
     GeneratorNew generator;
-    generator.init(U'〇');
-
-    sf::Image kernelImage;
-    kernelImage.create(60, 60, sf::Color::White);
-    sf::Texture kernelTexture;
-    kernelTexture.loadFromImage(kernelImage);
-
-    for (int size = 8; size < 20; size += 1) {
-        sf::Sprite kernelSprite;
-        kernelSprite.setTexture(kernelTexture);
-        kernelSprite.setOrigin(30, 30);
-
-        kernelSprite.setScale(size / 60.0, size / 60.0);
-        kernelSprite.setPosition(size, size);
-        generator.addKernel(kernelSprite, size / 60.0);
-
-        if (size % 2 == 1) continue;
-
-        for (double rotation = 15; rotation < 90; rotation += 15) {
-            kernelSprite.setRotation(rotation);
-            generator.addKernel(kernelSprite, size / 60.0);
-        }
+    if (!generator.init(U'〇')) {
+        std::cout << "failed to load font" << std::endl;
+        return 1;
     }
 
-    for (int size = 8; size < 20; size += 1) {
-        sf::Sprite kernelSprite;
-        kernelSprite.setTexture(kernelTexture);
-        kernelSprite.setOrigin(30, 30);
-        kernelSprite.setPosition(3*size, 3*size);
+    // a square and a 1:3 bar, every size and rotation of both resampled on the cpu
+    std::vector<uint8_t> square(60 * 60 * 4, 255);
+    std::vector<uint8_t> bar(20 * 60 * 4, 255);
 
-        kernelSprite.setScale(size / 60.0, size / 20.0);
-        generator.addKernel(kernelSprite, size / 20.0);
+    KernelBank bank;
+    bank.setSource(1, square.data(), 60, 60);
+    bank.setSource(2, bar.data(), 20, 60);
 
-        kernelSprite.setScale(size / 20.0, size / 60.0);
-        generator.addKernel(kernelSprite, size / 20.0);
-
-        if (size % 2 == 1) continue;
-
-        for (double rotation = 15; rotation < 180; rotation += 15) {
-            if (rotation == 90) continue;
-            kernelSprite.setRotation(rotation);
-            generator.addKernel(kernelSprite, size / 20.0);
-        }
+    std::vector<KernelSweep> sweeps;
+    for (int size = 8; size < 20; size += 1) {
+        // odd sizes only come unrotated, the bar also turned on its side
+        double squareRotation = size % 2 == 1 ? 0 : 75;
+        double barRotation = size % 2 == 1 ? 90 : 165;
+        double barStep = size % 2 == 1 ? 90 : 15;
+        sweeps.push_back({ 1, size / 120.0, size / 120.0, 0, 0, squareRotation, 15 });
+        sweeps.push_back({ 2, size / 40.0, size / 40.0, 0, 0, barRotation, barStep });
     }
+    // rebuilt only when the sources or sweeps change
+    auto fingerprint = bank.fingerprint(sweeps);
+    if (!bank.load("kernels.bank", fingerprint)) {
+        bank.build(sweeps);
+        bank.save("kernels.bank", fingerprint);
+    }
+    std::cout << bank.size() << " kernels" << std::endl;
+
+    generator.addKernels(bank);
 
     sf::Font font;
     font.loadFromFile("/Users/student/Desktop/NotoSansJP-Regular.ttf");    
@@ -84,6 +71,11 @@ int main() {
                 if (event.key.code == sf::Keyboard::Space) {
                     generator.step();
                     ++step;
+
+                    auto const& times = generator.getTimes();
+                    std::cout << "edges " << times.edges << "ms, field " << times.field << "ms, correlation "
+                        << times.correlation << "ms, selection " << times.selection << "ms, placement "
+                        << times.placement << "ms" << std::endl;
                 }
                 update = true;
             }
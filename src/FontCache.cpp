@@ -0,0 +1,267 @@
+#include <FontCache.hpp>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+using namespace tulip::text;
+
+// faces are opened once per file, a face is only ever used under the cache mutex
+struct FontCache::FreeType {
+	FT_Library library = nullptr;
+	std::map<std::string, FT_Face> faces;
+
+	FreeType() {
+		if (FT_Init_FreeType(&library) != 0) {
+			library = nullptr;
+		}
+	}
+
+	~FreeType() {
+		for (auto& [path, face] : faces) {
+			FT_Done_Face(face);
+		}
+		if (library) {
+			FT_Done_FreeType(library);
+		}
+	}
+
+	FT_Face face(std::string const& path, unsigned size) {
+		if (!library) {
+			return nullptr;
+		}
+
+		auto it = faces.find(path);
+		if (it == faces.end()) {
+			FT_Face face;
+			if (FT_New_Face(library, path.c_str(), 0, &face) != 0) {
+				return nullptr;
+			}
+			FT_Select_Charmap(face, FT_ENCODING_UNICODE);
+			it = faces.emplace(path, face).first;
+		}
+
+		if (FT_Set_Pixel_Sizes(it->second, 0, size) != 0) {
+			return nullptr;
+		}
+		return it->second;
+	}
+};
+
+FontCache::FontCache() : m_freeType(std::make_unique<FreeType>()) {}
+
+FontCache::~FontCache() = default;
+
+FontCache& FontCache::get() {
+	static FontCache s_ret;
+	return s_ret;
+}
+
+sf::Font* FontCache::loadFont(std::string const& path) {
+	auto it = m_fonts.find(path);
+	if (it != m_fonts.end()) {
+		return it->second.get();
+	}
+
+	auto font = std::make_unique<sf::Font>();
+	if (!font->loadFromFile(path)) {
+		return nullptr;
+	}
+	return m_fonts.emplace(path, std::move(font)).first->second.get();
+}
+
+sf::Font* FontCache::font(std::string const& path) {
+	std::lock_guard lock(m_mutex);
+	return this->loadFont(path);
+}
+
+std::vector<std::shared_ptr<GlyphBitmap>> FontCache::rasterizeSfml(
+	sf::Font& font, unsigned size, std::vector<char32_t> const& codepoints
+) {
+	// getGlyph renders into the atlas, so every missing glyph goes in before the one readback
+	std::vector<sf::Glyph> glyphs;
+	for (auto codepoint : codepoints) {
+		glyphs.push_back(font.getGlyph(codepoint, size, false));
+	}
+
+	auto atlas = font.getTexture(size).copyToImage();
+	auto const pixels = atlas.getPixelsPtr();
+	auto const atlasWidth = atlas.getSize().x;
+
+	std::vector<std::shared_ptr<GlyphBitmap>> ret;
+	for (auto const& glyph : glyphs) {
+		auto& bitmap = *ret.emplace_back(std::make_shared<GlyphBitmap>());
+		bitmap.glyph = glyph;
+		bitmap.width = glyph.textureRect.width;
+		bitmap.height = glyph.textureRect.height;
+		bitmap.alpha.resize(bitmap.width * bitmap.height);
+
+		for (size_t y = 0; y < bitmap.height; ++y) {
+			auto row = pixels + (size_t(glyph.textureRect.top) + y) * atlasWidth * 4;
+			for (size_t x = 0; x < bitmap.width; ++x) {
+				bitmap.alpha[y * bitmap.width + x] = row[(size_t(glyph.textureRect.left) + x) * 4 + 3];
+			}
+		}
+	}
+	return ret;
+}
+
+std::vector<std::shared_ptr<GlyphBitmap>> FontCache::rasterizeFreeType(
+	std::string const& path, unsigned size, std::vector<char32_t> const& codepoints
+) {
+	auto face = m_freeType->face(path, size);
+	if (!face) {
+		return {};
+	}
+
+	std::vector<std::shared_ptr<GlyphBitmap>> ret;
+	for (auto codepoint : codepoints) {
+		auto& bitmap = *ret.emplace_back(std::make_shared<GlyphBitmap>());
+
+		// same load flags as sf::Font, so both backends produce the same coverage
+		if (FT_Load_Char(face, codepoint, FT_LOAD_RENDER | FT_LOAD_TARGET_NORMAL | FT_LOAD_FORCE_AUTOHINT) != 0) {
+			continue;
+		}
+
+		auto const slot = face->glyph;
+		auto const& metrics = slot->metrics;
+		auto const& source = slot->bitmap;
+
+		bitmap.glyph.advance = float(metrics.horiAdvance) / float(1 << 6);
+		// where the rendered bitmap sits, hinting can move it off the outline's bearings
+		bitmap.glyph.bounds = sf::FloatRect(
+			float(slot->bitmap_left), -float(slot->bitmap_top), float(source.width), float(source.rows)
+		);
+		bitmap.glyph.textureRect = sf::IntRect(0, 0, int(source.width), int(source.rows));
+		bitmap.width = source.width;
+		bitmap.height = source.rows;
+		bitmap.alpha.resize(bitmap.width * bitmap.height);
+
+		for (size_t y = 0; y < bitmap.height; ++y) {
+			auto row = source.buffer + ptrdiff_t(y) * source.pitch;
+			for (size_t x = 0; x < bitmap.width; ++x) {
+				if (source.pixel_mode == FT_PIXEL_MODE_MONO) {
+					bitmap.alpha[y * bitmap.width + x] = ((row[x / 8] >> (7 - x % 8)) & 1) ? 255 : 0;
+				}
+				else {
+					bitmap.alpha[y * bitmap.width + x] = row[x];
+				}
+			}
+		}
+	}
+	return ret;
+}
+
+std::vector<std::shared_ptr<GlyphBitmap const>> FontCache::glyphs(
+	std::string const& path, unsigned size, std::vector<char32_t> const& codepoints, RasterBackend backend
+) {
+	std::lock_guard lock(m_mutex);
+
+	std::vector<std::shared_ptr<GlyphBitmap const>> ret(codepoints.size());
+	std::vector<size_t> missing;
+	std::vector<char32_t> missingCodepoints;
+	for (size_t i = 0; i < codepoints.size(); ++i) {
+		auto it = m_glyphs.find({ path, size, codepoints[i], backend });
+		if (it != m_glyphs.end()) {
+			ret[i] = it->second;
+		}
+		else {
+			missing.push_back(i);
+			missingCodepoints.push_back(codepoints[i]);
+		}
+	}
+
+	if (missing.empty()) {
+		return ret;
+	}
+
+	std::vector<std::shared_ptr<GlyphBitmap>> bitmaps;
+	if (backend == RasterBackend::FreeType) {
+		bitmaps = this->rasterizeFreeType(path, size, missingCodepoints);
+	}
+	else if (auto font = this->loadFont(path)) {
+		bitmaps = this->rasterizeSfml(*font, size, missingCodepoints);
+	}
+	if (bitmaps.empty()) {
+		return {};
+	}
+
+	for (size_t j = 0; j < missing.size(); ++j) {
+		auto i = missing[j];
+		ret[i] = m_glyphs.try_emplace({ path, size, codepoints[i], backend }, std::move(bitmaps[j])).first->second;
+	}
+
+	return ret;
+}
+
+std::vector<sf::Vector2f> FontCache::characterPositions(
+	std::string const& path, unsigned size, std::u32string const& text, RasterBackend backend
+) {
+	std::lock_guard lock(m_mutex);
+
+	std::vector<sf::Vector2f> ret;
+	if (backend == RasterBackend::Sfml) {
+		auto font = this->loadFont(path);
+		if (!font) {
+			return ret;
+		}
+
+		sf::Text textObject;
+		textObject.setFont(*font);
+		textObject.setCharacterSize(size);
+		textObject.setString(sf::String::fromUtf32(text.begin(), text.end()));
+		for (size_t i = 0; i < text.size(); ++i) {
+			ret.push_back(textObject.findCharacterPos(i));
+		}
+		return ret;
+	}
+
+	auto face = m_freeType->face(path, size);
+	if (!face) {
+		return ret;
+	}
+
+	// the same walk as sf::Text::findCharacterPos without letter or line spacing factors
+	auto const advance = [&](char32_t codepoint) {
+		if (FT_Load_Char(face, codepoint, FT_LOAD_TARGET_NORMAL | FT_LOAD_FORCE_AUTOHINT) != 0) {
+			return 0.0f;
+		}
+		return float(face->glyph->metrics.horiAdvance) / float(1 << 6);
+	};
+	auto const kerning = [&](char32_t first, char32_t second) {
+		if (first == 0 || !FT_HAS_KERNING(face)) {
+			return 0.0f;
+		}
+		FT_Vector vector;
+		FT_Get_Kerning(
+			face, FT_Get_Char_Index(face, first), FT_Get_Char_Index(face, second), FT_KERNING_DEFAULT, &vector
+		);
+		return FT_IS_SCALABLE(face) ? float(vector.x) / float(1 << 6) : float(vector.x);
+	};
+
+	auto const whitespace = advance(U' ');
+	auto const lineSpacing = float(face->size->metrics.height) / float(1 << 6);
+
+	sf::Vector2f position;
+	char32_t previous = 0;
+	for (auto codepoint : text) {
+		ret.push_back(position);
+
+		position.x += kerning(previous, codepoint);
+		previous = codepoint;
+
+		switch (codepoint) {
+			case U' ': position.x += whitespace; continue;
+			case U'\t': position.x += whitespace * 4; continue;
+			case U'\n': position.y += lineSpacing; position.x = 0; continue;
+		}
+		position.x += advance(codepoint);
+	}
+
+	return ret;
+}
+
+void FontCache::clear() {
+	std::lock_guard lock(m_mutex);
+	m_glyphs.clear();
+	m_fonts.clear();
+}
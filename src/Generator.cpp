@@ -1,70 +1,157 @@
 #include <Generator.hpp>
 #include <Geode/loader/Log.hpp>
+#include <Geode/loader/Mod.hpp>
 #include <SFML/Graphics.hpp>
 #include <fftw3.h>
 
+#include <oneapi/tbb/parallel_for.h>
 #include <oneapi/tbb/parallel_for_each.h>
+#include <oneapi/tbb/task_arena.h>
+#include <oneapi/tbb/task_group.h>
 
 #include <random>
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <execution>
+#include <limits>
 #include <locale>
 #include <codecvt> 
-
+#include <numeric>
+#include <optional>
+#include <type_traits>
+
+#include <DecompositionCache.hpp>
+#include <FontCache.hpp>
+#include <GlyphDecomposer.hpp>
+#include <ObjectReducer.hpp>
 #include <MatrixOperations.hpp>
 
 using namespace geode::prelude;
 using namespace tulip::text;
 
+namespace tbb = oneapi::tbb;
+
 namespace tulip::text {
 	struct GlyphData {
-		sf::Glyph glyph;
+		std::shared_ptr<GlyphBitmap const> bitmap;
 		char32_t codepoint;
 	};
 
-	struct GlyphVector2D {
-		std::vector<double> data;
-		size_t width;
-		size_t height;
-		char32_t codepoint;
-	};
-
-	struct ConvolutionScore {
-		double score = 0.0f;
-		size_t x = 0;
-		size_t y = 0;
-		size_t kernelId = 0;
+	// hands a wall clock budget out to glyphs or regions as they start, in proportion to the pixels
+	// they have left to cover among everything not started yet, so time one leaves unused goes to the rest
+	class TimeBudget {
+		std::chrono::steady_clock::time_point m_end;
+		std::atomic<size_t> m_remainingWeight;
+		double m_concurrency;
+
+	public:
+		TimeBudget(std::chrono::steady_clock::time_point end, size_t weight) :
+			m_end(end),
+			m_remainingWeight(weight),
+			m_concurrency(tbb::this_task_arena::max_concurrency()) {}
+
+		// the deadline of an item about to start
+		std::chrono::steady_clock::time_point start(size_t weight) {
+			auto const remaining = m_remainingWeight.fetch_sub(weight);
+			auto const now = std::chrono::steady_clock::now();
+			if (now >= m_end || weight >= remaining) {
+				return m_end;
+			}
+			// items run side by side, so one may take up to all that is left
+			auto const share = std::min(1.0, m_concurrency * double(weight) / double(remaining));
+			return now + std::chrono::duration_cast<std::chrono::steady_clock::duration>((m_end - now) * share);
+		}
 	};
 }
 
 class Generator::Impl {
 public:
+	// generations share the caches below, so they run one at a time
+	std::mutex m_createMutex;
+	tbb::task_arena m_arena;
+	tbb::task_group m_tasks;
+
+	Impl();
+	~Impl();
+
+	size_t m_kernelHash = 0;
+	std::mutex m_kernelMutex;
+	GlyphDecomposer m_decomposer;
+	std::optional<ObjectReducer> m_reducer;
+
+	static size_t hashKernels(std::vector<ObjectKernel> const& kernels);
+
+	void updateKernels(GeneratorConfig const& config);
+
+	bool m_wisdomLoaded = false;
+
+	void preparePlans(GeneratorConfig const& config);
+	void savePlans();
+
+	DecompositionCache m_decompositions{ 1024 };
+	// font contents are only rehashed when the file changes
+	std::map<std::string, std::pair<ghc::filesystem::file_time_type, uint64_t>> m_fontHashes;
+
+	uint64_t getFontHash(ghc::filesystem::path const& path);
+
+	template <class Real>
+	static ghc::filesystem::path getWisdomPath();
 
 	std::vector<GlyphData> getUniqueGlyphs(
-		std::u32string const& text, GeneratorConfig const& config, sf::Font& font
+		std::u32string const& text, GeneratorConfig const& config
 	);	
 
-	std::map<char32_t, GlyphVector2D> getGlyphVectors(
-		std::vector<GlyphData> const& glyphs, GeneratorConfig const& config, sf::Image const& fontImage
-	);
+	std::map<char32_t, GlyphVector2D> getGlyphVectors(std::vector<GlyphData> const& glyphs);
 
 	void addNegativeScores(
 		std::map<char32_t, GlyphVector2D>& glyphVectors, GeneratorConfig const& config
 	);
 
-	std::vector<ConvolutionScore> getScoresForGlyph(
-		GlyphVector2D& glyphVector, GeneratorConfig const& config
+	// top left of a glyph's bitmap in layout pixels, cursor being its pen position
+	static sf::Vector2i glyphOrigin(
+		sf::Vector2f cursor, GlyphBitmap const& bitmap, GeneratorConfig const& config
 	);
 
-	ConvolutionScore getConvolutionScore(
-		GlyphVector2D const& glyphVector, ObjectKernel const& kernel, GeneratorConfig const& config
-	) const;
+	// the object for a score relative to a raster whose top left is at origin in layout pixels
+	static CreatedObject makeObject(ConvolutionScore const& score, sf::Vector2i origin, GeneratorConfig const& config);
 
-	std::vector<CreatedObject> create(std::u32string const& text, GeneratorConfig const& config);
+	static void addObjects(
+		std::vector<CreatedObject>& objects, std::vector<ConvolutionScore> const& scores, sf::Vector2i origin,
+		GeneratorConfig const& config
+	);
+
+	// whether the text is decomposed as one composed raster instead of glyph by glyph
+	static bool prefersWholeString(std::u32string const& text, GeneratorConfig const& config);
+
+	// sets the coverage and placed objects of report
+	std::vector<CreatedObject> createWholeString(
+		std::u32string const& text, std::vector<GlyphData> const& glyphs,
+		std::vector<sf::Vector2f> const& cursors, GeneratorConfig const& config, GenerationControl const& control,
+		GenerationProgress& report
+	);
+
+	std::vector<CreatedObject> create(
+		std::u32string const& text, GeneratorConfig const& config, GenerationControl const& control,
+		GenerationProgress& report
+	);
 };
 
+Generator::Impl::Impl() {
+	m_decomposer.setLog([](std::string const& message) {
+		log::debug("{}", message);
+	});
+}
+
+Generator::Impl::~Impl() {
+	// background generations still use this
+	m_arena.execute([&] {
+		m_tasks.wait();
+	});
+}
+
 std::vector<GlyphData> Generator::Impl::getUniqueGlyphs(
-	std::u32string const& text, GeneratorConfig const& config, sf::Font& font
+	std::u32string const& text, GeneratorConfig const& config
 ) {
 	std::vector<char32_t> chars;
 
@@ -76,33 +163,28 @@ std::vector<GlyphData> Generator::Impl::getUniqueGlyphs(
 
 	std::vector<GlyphData> ret;
 
-	for (auto const& c : chars) {
-		ret.push_back({font.getGlyph(c, config.fontSize, false), c});
+	auto bitmaps = FontCache::get().glyphs(
+		config.fontPath.string(), config.fontSize, chars, config.rasterBackend
+	);
+	for (size_t i = 0; i < bitmaps.size(); ++i) {
+		ret.push_back({ std::move(bitmaps[i]), chars[i] });
 	}
 
 	return ret;
 }
 
-std::map<char32_t, GlyphVector2D> Generator::Impl::getGlyphVectors(
-	std::vector<GlyphData> const& glyphs, GeneratorConfig const& config, sf::Image const& fontImage
-) {
+std::map<char32_t, GlyphVector2D> Generator::Impl::getGlyphVectors(std::vector<GlyphData> const& glyphs) {
 	std::map<char32_t, GlyphVector2D> ret;
 
-	for (auto const& [glyph, codepoint] : glyphs) {
+	for (auto const& [bitmap, codepoint] : glyphs) {
 		GlyphVector2D vec;
-		vec.width = glyph.bounds.width;
-		vec.height = glyph.bounds.height;
+		vec.width = bitmap->width;
+		vec.height = bitmap->height;
 		vec.codepoint = codepoint;
 
-		sf::Image glyphImage;
-		glyphImage.create(vec.width, vec.height);
-		glyphImage.copy(fontImage, 0, 0, glyph.textureRect);
-
-		for (size_t y = 0; y < vec.height; ++y) {
-			for (size_t x = 0; x < vec.width; ++x) {
-				auto color = glyphImage.getPixel(x, y);
-				vec.data.push_back(color.a / 255.0f);
-			}
+		vec.data.reserve(bitmap->alpha.size());
+		for (auto alpha : bitmap->alpha) {
+			vec.data.push_back(alpha / 255.0f);
 		}
 		
 		ret[codepoint] = vec;
@@ -123,295 +205,470 @@ void Generator::Impl::addNegativeScores(
 	}
 }
 
-ConvolutionScore Generator::Impl::getConvolutionScore(
-	GlyphVector2D const& glyphVector, ObjectKernel const& kernel, GeneratorConfig const& config, ConvolutionData& data
-) const {
-	ConvolutionScore ret;
-	ret.score = 0.0f;
+size_t Generator::Impl::hashKernels(std::vector<ObjectKernel> const& kernels) {
+	size_t hash = kernels.size();
+	auto combine = [&](size_t value) {
+		hash ^= value + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+	};
 
-	auto width = glyphVector.width + kernel.width - 1;
-	auto height = glyphVector.height + kernel.height - 1;
+	for (auto const& kernel : kernels) {
+		combine(kernel.width);
+		combine(kernel.height);
+		for (auto const& value : kernel.data) {
+			combine(std::hash<double>()(value));
+		}
+	}
 
-	auto imageInput = data.imageInput;
-	auto kernelInput = data.kernelInput;
-	auto imageOutput = data.imageOutput;
-	auto kernelOutput = data.kernelOutput;
-	auto convolutionOutput = data.convolutionOutput;
-	auto imagePlan = data.imagePlan;
-	auto kernelPlan = data.kernelPlan;
-	auto convolutionPlan = data.convolutionPlan;
+	return hash;
+}
 
+void Generator::Impl::updateKernels(GeneratorConfig const& config) {
+	auto kernelHash = this->hashKernels(config.kernels);
 
-	for (size_t y = 0; y < glyphVector.height; ++y) {
-		for (size_t x = 0; x < glyphVector.width; ++x) {
-			auto index = y * glyphVector.width + x;
-			auto index2 = y * width + x;
-			imageInput[index2] = glyphVector.data[index];
-		}
+	std::lock_guard lock(m_kernelMutex);
+	if (kernelHash != m_kernelHash || !m_reducer) {
+		m_kernelHash = kernelHash;
+		m_decomposer.setKernels(config.kernels);
+		m_reducer.emplace(config.kernels);
 	}
+}
 
-	for (size_t y = 0; y < kernel.height; ++y) {
-		for (size_t x = 0; x < kernel.width; ++x) {
-			auto index = y * kernel.width + x;
-			auto index2 = y * width + x;
-			kernelInput[index2] = kernel.data[index];
+template <class Real>
+ghc::filesystem::path Generator::Impl::getWisdomPath() {
+	// fftw and fftwf keep separate wisdom
+	if constexpr (std::is_same_v<Real, float>) {
+		return Mod::get()->getSaveDir() / "fftwf.wisdom";
+	}
+	else {
+		return Mod::get()->getSaveDir() / "fftw.wisdom";
+	}
+}
+
+void Generator::Impl::preparePlans(GeneratorConfig const& config) {
+	unsigned flags = FFTW_ESTIMATE;
+	switch (config.planningEffort) {
+		case PlanningEffort::Estimate: flags = FFTW_ESTIMATE; break;
+		case PlanningEffort::Measure: flags = FFTW_MEASURE; break;
+		case PlanningEffort::Patient: flags = FFTW_PATIENT; break;
+	}
+	PlanCache<double>::get().setFlags(flags);
+	PlanCache<float>::get().setFlags(flags);
+
+	if (!m_wisdomLoaded) {
+		if (PlanCache<double>::get().loadWisdom(getWisdomPath<double>().string())) {
+			log::debug("Loaded fftw wisdom from {}", getWisdomPath<double>().string());
+		}
+		if (PlanCache<float>::get().loadWisdom(getWisdomPath<float>().string())) {
+			log::debug("Loaded fftwf wisdom from {}", getWisdomPath<float>().string());
 		}
+		m_wisdomLoaded = true;
 	}
+}
 
-	
+void Generator::Impl::savePlans() {
+	if (PlanCache<double>::get().saveWisdom(getWisdomPath<double>().string())) {
+		log::debug("Saved fftw wisdom to {}", getWisdomPath<double>().string());
+	}
+	if (PlanCache<float>::get().saveWisdom(getWisdomPath<float>().string())) {
+		log::debug("Saved fftwf wisdom to {}", getWisdomPath<float>().string());
+	}
+}
 
-	// find best score
-	for (size_t y = 0; y < height; ++y) {
-		for (size_t x = 0; x < width; ++x) {
-			auto index = y * width + x;
+uint64_t Generator::Impl::getFontHash(ghc::filesystem::path const& path) {
+	std::error_code error;
+	auto time = ghc::filesystem::last_write_time(path, error);
 
-			auto score = convolutionOutput[index];
+	auto& [hashedTime, hash] = m_fontHashes[path.string()];
+	if (hash == 0 || hashedTime != time) {
+		hash = DecompositionCache::hashFile(path);
+		hashedTime = time;
+	}
+	return hash;
+}
 
-			if (score > ret.score + 0.1) {
-				ret.score = score;
-				ret.x = x - kernel.width + 1;
-				ret.y = y - kernel.height + 1;
-			}
+sf::Vector2i Generator::Impl::glyphOrigin(
+	sf::Vector2f cursor, GlyphBitmap const& bitmap, GeneratorConfig const& config
+) {
+	// the cursor is on the top of the line, glyph bounds are relative to the baseline below it
+	return sf::Vector2i(
+		int32_t(std::round(cursor.x + bitmap.glyph.bounds.left)),
+		int32_t(std::round(cursor.y + float(unsigned(config.fontSize)) + bitmap.glyph.bounds.top))
+	);
+}
+
+CreatedObject Generator::Impl::makeObject(
+	ConvolutionScore const& score, sf::Vector2i origin, GeneratorConfig const& config
+) {
+	auto& kernel = config.kernels[score.kernelId];
+	// create the object
+	CreatedObject object;
+	// TODO: config.anchor
+	object.x = config.positionX + kernel.offsetX + double(origin.x + score.x) / 2; // (60x60)
+	object.y = config.positionY + kernel.offsetY - double(origin.y + score.y) / 2;
+	object.objectId = kernel.objectId;
+	object.scale = kernel.scale;
+	object.rotation = kernel.rotation;
+	return object;
+}
+
+void Generator::Impl::addObjects(
+	std::vector<CreatedObject>& objects, std::vector<ConvolutionScore> const& scores, sf::Vector2i origin,
+	GeneratorConfig const& config
+) {
+	for (auto& score : scores) {
+		// add the object to the list
+		objects.push_back(makeObject(score, origin, config));
+	}
+}
+
+bool Generator::Impl::prefersWholeString(std::u32string const& text, GeneratorConfig const& config) {
+	switch (config.layoutMode) {
+		case LayoutMode::PerGlyph: return false;
+		case LayoutMode::WholeString: return true;
+		case LayoutMode::Automatic: break;
+	}
+
+	// a glyph that appears once gains nothing from being decomposed and cached on its own
+	std::map<char32_t, size_t> counts;
+	size_t visible = 0;
+	for (auto c : text) {
+		if (c == U' ' || c == U'\t' || c == U'\n') {
+			continue;
 		}
+		++counts[c];
+		++visible;
 	}
+	auto const single = std::count_if(counts.begin(), counts.end(), [](auto const& count) {
+		return count.second == 1;
+	});
+	return visible >= size_t(config.wholeStringLength) && size_t(single) * 2 > visible;
+}
+
+std::vector<CreatedObject> Generator::Impl::createWholeString(
+	std::u32string const& text, std::vector<GlyphData> const& glyphs,
+	std::vector<sf::Vector2f> const& cursors, GeneratorConfig const& config, GenerationControl const& control,
+	GenerationProgress& report
+) {
+	report.coverage = 1.0;
 
-	// revert the inputs
-	for (size_t y = 0; y < glyphVector.height; ++y) {
-		for (size_t x = 0; x < glyphVector.width; ++x) {
-			auto index = y * glyphVector.width + x;
-			auto index2 = y * width + x;
-			imageInput[index2] = config.negativeScore;
+	std::map<char32_t, GlyphBitmap const*> bitmaps;
+	for (auto const& glyph : glyphs) {
+		bitmaps[glyph.codepoint] = glyph.bitmap.get();
+	}
+
+	struct GlyphBox {
+		sf::Vector2i origin;
+		GlyphBitmap const* bitmap;
+	};
+
+	std::vector<GlyphBox> boxes;
+	int32_t left = std::numeric_limits<int32_t>::max(), top = left;
+	int32_t right = std::numeric_limits<int32_t>::min(), bottom = right;
+	for (size_t i = 0; i < text.size(); ++i) {
+		auto bitmap = bitmaps[text[i]];
+		if (bitmap->width == 0 || bitmap->height == 0) {
+			continue;
 		}
+
+		auto origin = glyphOrigin(cursors[i], *bitmap, config);
+		boxes.push_back({ origin, bitmap });
+		left = std::min(left, origin.x);
+		top = std::min(top, origin.y);
+		right = std::max(right, origin.x + int32_t(bitmap->width));
+		bottom = std::max(bottom, origin.y + int32_t(bitmap->height));
+	}
+
+	if (boxes.empty()) {
+		return {};
 	}
 
-	for (size_t y = 0; y < kernel.height; ++y) {
-		for (size_t x = 0; x < kernel.width; ++x) {
-			auto index = y * kernel.width + x;
-			auto index2 = y * width + x;
-			kernelInput[index2] = 0.0;
+	// overlapping glyphs cover the union of their pixels
+	GlyphVector2D field;
+	field.width = right - left;
+	field.height = bottom - top;
+	field.codepoint = 0;
+
+	std::vector<uint8_t> alpha(field.width * field.height, 0);
+	for (auto& box : boxes) {
+		box.origin -= sf::Vector2i(left, top);
+		for (size_t y = 0; y < box.bitmap->height; ++y) {
+			for (size_t x = 0; x < box.bitmap->width; ++x) {
+				auto& value = alpha[(box.origin.y + y) * field.width + box.origin.x + x];
+				value = std::max(value, box.bitmap->alpha[y * box.bitmap->width + x]);
+			}
 		}
 	}
 
-	return ret;
-}
+	// the same values getGlyphVectors and addNegativeScores give a single glyph
+	field.data.reserve(alpha.size());
+	for (auto value : alpha) {
+		auto scaled = value / 255.0f;
+		field.data.push_back(scaled < 0.8f ? config.negativeScore : scaled);
+	}
+	auto const glyphPixels = countPositive(field);
+	// the optimizer starts again from the raster as nothing was placed on it
+	std::vector<double> original;
+	if (config.optimizeObjects) {
+		original = field.data;
+	}
 
-std::vector<ConvolutionScore> Generator::Impl::getScoresForGlyph(
-	GlyphVector2D& glyphVector, GeneratorConfig const& config
-) {
-	std::vector<ConvolutionScore> ret;
-
-	log::debug("Calculating scores for glyph");
-
-	// create kernel ids
-	std::vector<size_t> kernelIds(config.kernels.size());
-	std::iota(kernelIds.begin(), kernelIds.end(), 0);
-
-	for (size_t y = 0; y < glyphVector.height; ++y) {
-		for (size_t x = 0; x < glyphVector.width; ++x) {
-			auto index = y * glyphVector.width + x;
-			std::cout << (glyphVector.data[index] > 0.0 ? '#' : ' ') << ' ';
-		}
-		std::cout << '\n';
-	}
-
-	log::debug("Calculating scores for glyph: {} kernels", kernelIds.size());
-
-	ConvolutionData data;
-	size_t maxKernelWidth = 0, maxKernelHeight = 0;
-	for (int i = 0; i < config.kernels.size(); ++i) {
-		auto& kernel = config.kernels[i];
-		maxKernelWidth = std::max(maxKernelWidth, kernel.width);
-		maxKernelHeight = std::max(maxKernelHeight, kernel.height);
-	}
-	auto width = glyphVector.width + maxKernelWidth - 1;
-	auto height = glyphVector.height + maxKernelHeight - 1;
-
-	for (size_t y = 0; y < height; ++y) {
-		for (size_t x = 0; x < width; ++x) {
-			auto index = y * width + x;
-			data.imageInput[index] = config.negativeScore;
-			data.kernelInput[index] = 0.0;
-		}
-	}
-	// repeat for every object added to glyph
-	for (size_t objectIndex = 0; objectIndex < config.objectsPerGlyph; ++objectIndex) {
-		std::mutex mutex;
-		ConvolutionScore bestScore;
-
-		log::debug("Calculating scores for glyph: object {}", objectIndex);
-
-		struct Body {
-			using argument_type = size_t;
-			Generator::Impl const* impl;
-			GlyphVector2D const& glyphVector;
-			GeneratorConfig const& config;
-			std::mutex& mutex;
-			ConvolutionScore& bestScore;
-			ConvolutionData& fftwData;
-
-			Body(
-				Generator::Impl const* impl,
-				GlyphVector2D const& glyphVector,
-				GeneratorConfig const& config,
-				std::mutex& mutex,
-				ConvolutionScore& bestScore,
-				ConvolutionData& fftwData
-			) :
-				impl(impl),
-				glyphVector(glyphVector),
-				config(config),
-				mutex(mutex),
-				bestScore(bestScore),
-				fftwData(fftwData)
-			{}
-
-			void operator()(size_t id/*, oneapi::tbb::feeder<size_t>& feeder*/) const {
-				// calculate convolution score
-				std::unique_lock<std::mutex> lock(mutex);
-				auto& kernel = config.kernels[id];
-				auto& data = fftwData;
-				lock.unlock();
-
-				if (kernel.width > glyphVector.width || kernel.height > glyphVector.height) {
-					return;
-				}
+	size_t maxKernelSize = 0;
+	for (auto const& kernel : config.kernels) {
+		maxKernelSize = std::max({ maxKernelSize, size_t(kernel.width), size_t(kernel.height) });
+	}
 
-				auto score = impl->getConvolutionScore(glyphVector, kernel, config, data);
-				score.kernelId = id;
+	// a kernel crossing a seam lies within maxKernelSize of it, so strips around neighbouring seams
+	// stay apart as long as tiles are over twice that
+	auto const tileSize = std::max(size_t(std::max(config.layoutTileSize, 1)), 2 * maxKernelSize + 1);
+	auto const columns = (field.width + tileSize - 1) / tileSize;
+	auto const rows = (field.height + tileSize - 1) / tileSize;
 
-				// if better than best, update best
-				lock.lock();
-				if (score.score >= bestScore.score) {
-					bestScore = score;
-				}
-				lock.unlock();
+	log::debug("Decomposing {}x{} text raster in {}x{} tiles", field.width, field.height, columns, rows);
+
+	// every tile and every seam is one step of progress
+	auto const regionCount = columns * rows + (columns - 1) + (rows - 1);
+	std::atomic<size_t> finishedRegions = 0;
+	if (control.progress) {
+		control.progress(0, regionCount);
+	}
+
+	auto regionWeight = [&](size_t regionLeft, size_t regionTop, size_t regionRight, size_t regionBottom) {
+		size_t ret = 0;
+		for (auto y = regionTop; y < regionBottom; ++y) {
+			auto row = field.data.begin() + y * field.width;
+			ret += std::count_if(row + regionLeft, row + regionRight, [](double value) {
+				return value > 0.0;
+			});
+		}
+		return ret;
+	};
+
+	// the seams get a share of the budget kept back from the tiles, about what they took without one
+	bool const splitBudget = config.timeBudget.count() > 0 && control.deadline;
+	auto phaseEnd = [&](double fraction) {
+		auto const now = std::chrono::steady_clock::now();
+		auto const end = *control.deadline;
+		if (now >= end) {
+			return end;
+		}
+		return now + std::chrono::duration_cast<std::chrono::steady_clock::duration>((end - now) * fraction);
+	};
+
+	// decomposes part of the field on its own and writes back what it left uncovered inside it
+	// placements only hang over the edges of the field, never into the rest of it, so regions
+	// decomposed at the same time never cover the same pixels
+	auto decomposeRegion = [&](
+		size_t regionLeft, size_t regionTop, size_t regionRight, size_t regionBottom, TimeBudget* budget
+	) {
+		std::vector<ConvolutionScore> scores;
+		auto finishRegion = [&] {
+			auto finished = ++finishedRegions;
+			if (control.progress) {
+				control.progress(finished, regionCount);
 			}
 		};
 
-		log::debug("Calculating scores for glyph: object {}: {} kernels", objectIndex, kernelIds.size());
+		size_t glyphCount = 0;
+		for (auto const& box : boxes) {
+			auto const boxRight = box.origin.x + int32_t(box.bitmap->width);
+			auto const boxBottom = box.origin.y + int32_t(box.bitmap->height);
+			if (box.origin.x < int32_t(regionRight) && boxRight > int32_t(regionLeft) &&
+				box.origin.y < int32_t(regionBottom) && boxBottom > int32_t(regionTop)) {
+				++glyphCount;
+			}
+		}
+		if (glyphCount == 0 || control.stopped()) {
+			finishRegion();
+			return scores;
+		}
 
-		auto body = Body(
-			this,
-			glyphVector,
-			config,
-			mutex,
-			bestScore,
-			data
-		);
-		// for each convolution id
-		// oneapi::tbb::parallel_for_each(kernelIds.begin(), kernelIds.end(), body);
-		for (auto id : kernelIds) {
-			body(id);
+		GlyphVector2D region;
+		region.width = regionRight - regionLeft;
+		region.height = regionBottom - regionTop;
+		region.codepoint = 0;
+		region.clipped = ClippedEdges{
+			regionLeft > 0, regionTop > 0, regionRight < field.width, regionBottom < field.height
+		};
+		for (auto y = regionTop; y < regionBottom; ++y) {
+			auto row = field.data.begin() + y * field.width;
+			region.data.insert(region.data.end(), row + regionLeft, row + regionRight);
 		}
 
-		// break;
+		auto const regionOrigin = sf::Vector2i(left + int32_t(regionLeft), top + int32_t(regionTop));
+		PlacedCallback placed;
+		if (control.object && !config.optimizeObjects) {
+			placed = [&](ConvolutionScore const& score) {
+				control.object(makeObject(score, regionOrigin, config));
+			};
+		}
+		auto const regionControl = control.until(
+			budget ? std::optional(budget->start(countPositive(region))) : std::nullopt
+		);
+		scores = m_decomposer.decompose(
+			region, config, glyphCount * config.objectsPerGlyph, regionControl, placed
+		);
 
-		if (bestScore.score < config.minScore) {
-			break;
+		for (auto y = regionTop; y < regionBottom; ++y) {
+			std::copy_n(
+				region.data.begin() + (y - regionTop) * region.width, region.width,
+				field.data.begin() + y * field.width + regionLeft
+			);
 		}
+		for (auto& score : scores) {
+			score.x += int32_t(regionLeft);
+			score.y += int32_t(regionTop);
+		}
+		finishRegion();
+		return scores;
+	};
 
-		log::debug("Applying convolution {} to glyph {}, {}", bestScore.kernelId, bestScore.x, bestScore.y);
+	std::optional<TimeBudget> tileBudget;
+	if (splitBudget) {
+		tileBudget.emplace(phaseEnd(columns > 1 || rows > 1 ? 0.75 : 1.0), glyphPixels);
+	}
 
-		// apply the best convolution
-		auto& kernel = config.kernels[bestScore.kernelId];
-		
-		for (size_t y = 0; y < kernel.height; ++y) {
-			for (size_t x = 0; x < kernel.width; ++x) {
-				auto index = y * kernel.width + x;
-				auto index2 = (y + bestScore.y) * glyphVector.width + (x + bestScore.x);
-
-				// if kernel is positive and glyph is positive, subtract kernel from glyph
-				if (kernel.data[index] > 0.0f && glyphVector.data[index2] > 0.0f) {
-					// square the kernel because handling transparency is hard
-					// glyphVector.data[index2] -= kernel.data[index] * kernel.data[index];
-					// if (glyphVector.data[index2] <= 0.0f) {
-					// 	glyphVector.data[index2] = -1.0f;
-					// }
-					glyphVector.data[index2] = 0;
-				}
-			}
+	std::vector<std::vector<ConvolutionScore>> tileScores(columns * rows);
+	tbb::parallel_for(size_t(0), columns * rows, [&](size_t index) {
+		auto column = index % columns;
+		auto row = index / columns;
+		tileScores[index] = decomposeRegion(
+			column * tileSize, row * tileSize, std::min((column + 1) * tileSize, field.width),
+			std::min((row + 1) * tileSize, field.height), tileBudget ? &*tileBudget : nullptr
+		);
+	});
+
+	// tile objects stay inside their tile, what they left along the seams is decomposed in strips
+	// straddling them that every kernel crossing a seam fits in, the vertical seams first and then
+	// the horizontal ones over the result
+	std::optional<TimeBudget> columnSeamBudget;
+	if (splitBudget) {
+		size_t weight = 0;
+		for (size_t column = 1; column < columns; ++column) {
+			auto seam = column * tileSize;
+			weight += regionWeight(seam - maxKernelSize, 0, std::min(seam + maxKernelSize, field.width), field.height);
 		}
+		columnSeamBudget.emplace(phaseEnd(rows > 1 ? 0.5 : 1.0), weight);
+	}
+
+	std::vector<std::vector<ConvolutionScore>> columnSeamScores(columns > 0 ? columns - 1 : 0);
+	tbb::parallel_for(size_t(1), std::max<size_t>(columns, 1), [&](size_t column) {
+		auto seam = column * tileSize;
+		columnSeamScores[column - 1] = decomposeRegion(
+			seam - maxKernelSize, 0, std::min(seam + maxKernelSize, field.width), field.height,
+			columnSeamBudget ? &*columnSeamBudget : nullptr
+		);
+	});
+
+	std::optional<TimeBudget> rowSeamBudget;
+	if (splitBudget) {
+		size_t weight = 0;
+		for (size_t row = 1; row < rows; ++row) {
+			auto seam = row * tileSize;
+			weight += regionWeight(0, seam - maxKernelSize, field.width, std::min(seam + maxKernelSize, field.height));
+		}
+		rowSeamBudget.emplace(phaseEnd(1.0), weight);
+	}
+
+	std::vector<std::vector<ConvolutionScore>> rowSeamScores(rows > 0 ? rows - 1 : 0);
+	tbb::parallel_for(size_t(1), std::max<size_t>(rows, 1), [&](size_t row) {
+		auto seam = row * tileSize;
+		rowSeamScores[row - 1] = decomposeRegion(
+			0, seam - maxKernelSize, field.width, std::min(seam + maxKernelSize, field.height),
+			rowSeamBudget ? &*rowSeamBudget : nullptr
+		);
+	});
 
-		auto width = (glyphVector.width + kernel.width - 1);
-		auto height = (glyphVector.height + kernel.height - 1);
-
-		// for (size_t y = 0; y < height; ++y) {
-		// 	for (size_t x = 0; x < width; ++x) {
-		// 		auto index = y * width + x;
-		// 		auto input = fftwData[bestScore.kernelId].input;;
-		// 		std::cout << (input[index] < 0.1 ? '.' : '#') << ' ';
-		// 	}
-		// 	std::cout << '\n';
-		// }
-		// for (size_t i = 0; i < width; ++i) {
-		// 	std::cout << "--";
-		// }
-		// std::cout << '\n';
-		// for (size_t y = 0; y < height; ++y) {
-		// 	for (size_t x = 0; x < width; ++x) {
-		// 		auto index = y * width + x;
-		// 		auto kernelInput = fftwData[bestScore.kernelId].kernelInput;;
-		// 		std::cout << (kernelInput[index]<= 0.0 ? '.' : '#')  << ' ';
-		// 	}
-		// 	std::cout << '\n';
-		// }
-		// for (size_t i = 0; i < width; ++i) {
-		// 	std::cout << "--";
-		// }
-		// std::cout << '\n';
-		// for (size_t y = 0; y < height; ++y) {
-		// 	for (size_t x = 0; x < width; ++x) {
-		// 		auto index = y * width + x;
-		// 		auto convolutionOutput = fftwData[bestScore.kernelId].convolutionOutput;;
-		// 		auto value = (int)std::round(convolutionOutput[index]);
-
-		// 		if (value >= 10) {
-		// 			std::cout << value << ' ';
-		// 		}
-		// 		else if (value >= 0) {
-		// 			std::cout << value << "  ";
-		// 		}
-		// 		else {
-		// 			std::cout << " . ";
-		// 		}
-		// 	}
-		// 	std::cout << '\n';
-		// }
-
-		log::debug("Glyph score: {}", bestScore.score);
-
-		// add the score to the list
-		ret.push_back(bestScore);
-
-		for (size_t y = 0; y < glyphVector.height; ++y) {
-			for (size_t x = 0; x < glyphVector.width; ++x) {
-				auto index = y * glyphVector.width + x;
-				std::cout << (glyphVector.data[index] > 0.0 ? '#' : ' ') << ' ';
+	// merged in a fixed order so the result does not depend on scheduling
+	std::vector<ConvolutionScore> scores;
+	for (auto const* scoreLists : { &tileScores, &columnSeamScores, &rowSeamScores }) {
+		for (auto const& regionScores : *scoreLists) {
+			scores.insert(scores.end(), regionScores.begin(), regionScores.end());
+		}
+	}
+	report.placedObjects = scores.size();
+
+	if (config.optimizeObjects) {
+		// the whole raster is one list of placements, so it is optimized in one piece
+		if (!control.stopped()) {
+			scores = m_reducer->reduce(
+				original.data(), field.width, field.height, config.negativeScore, scores, config.objectTolerance,
+				config.minScore
+			);
+			field.data = std::move(original);
+			coverPixels(field, scores, config);
+
+			log::debug("Optimized {} objects to {}", report.placedObjects, scores.size());
+		}
+		if (control.object) {
+			for (auto const& score : scores) {
+				control.object(makeObject(score, sf::Vector2i(left, top), config));
 			}
-			std::cout << '\n';
 		}
 	}
 
-	log::debug("Calculated scores for glyph");
+	if (glyphPixels > 0) {
+		report.coverage = 1.0 - double(countPositive(field)) / double(glyphPixels);
+	}
 
+	std::vector<CreatedObject> ret;
+	addObjects(ret, scores, sf::Vector2i(left, top), config);
 	return ret;
 }
 
 std::vector<CreatedObject> Generator::Impl::create(
-	std::u32string const& text, GeneratorConfig const& config
+	std::u32string const& text, GeneratorConfig const& config, GenerationControl const& outerControl,
+	GenerationProgress& report
 ) {
+	std::lock_guard lock(m_createMutex);
+
 	log::debug("Creating text");
 
-	// get all unique glyphs in text
-	sf::Font font;
-	font.loadFromFile(config.fontPath);
-	auto glyphs = this->getUniqueGlyphs(text, config, font);
+	report.coverage = 0.0;
+	report.placedObjects = 0;
+
+	// the budget counts from here, the font, layout and plans included
+	std::optional<std::chrono::steady_clock::time_point> budgetEnd;
+	if (config.timeBudget.count() > 0) {
+		budgetEnd = std::chrono::steady_clock::now() + config.timeBudget;
+	}
+	auto const control = outerControl.until(budgetEnd);
+
+	// get all unique glyphs in text, the font and its glyphs stay cached between calls
+	auto glyphs = this->getUniqueGlyphs(text, config);
+	if (glyphs.empty() && !text.empty()) {
+		log::error("Failed to load font {}", config.fontPath.string());
+		return {};
+	}
 
 	log::debug("Found {} unique glyphs", glyphs.size());
 
+	// lay out the text with the same backend that rasterized it
+	auto cursors = FontCache::get().characterPositions(
+		config.fontPath.string(), config.fontSize, text, config.rasterBackend
+	);
+
+	if (cursors.size() != text.size()) {
+		log::error("Failed to lay out text with font {}", config.fontPath.string());
+		return {};
+	}
+
+	log::debug("Laid out text");
+
+	this->preparePlans(config);
+	this->updateKernels(config);
+
+	if (prefersWholeString(text, config)) {
+		log::debug("Decomposing the whole string");
+
+		auto ret = this->createWholeString(text, glyphs, cursors, config, control, report);
+		this->savePlans();
+
+		log::debug("Created {} objects, {} coverage", ret.size(), report.coverage);
+		return ret;
+	}
+
 	// get matrix representations for each
-	sf::Image fontImage = font.getTexture(config.fontSize).copyToImage();
-	auto glyphVectors = this->getGlyphVectors(glyphs, config, fontImage);
+	auto glyphVectors = this->getGlyphVectors(glyphs);
 
 	log::debug("Created {} glyph vectors", glyphVectors.size());
 
@@ -422,55 +679,176 @@ std::vector<CreatedObject> Generator::Impl::create(
 
 	log::debug("Calculating convolution scores");
 
-	// for each glyph
-	for (auto& [codepoint, glyphVector] : glyphVectors) {
-		log::debug("Calculating convolution scores");
+	if (config.persistDecompositions) {
+		m_decompositions.setDirectory(Mod::get()->getSaveDir() / "decompositions");
+	}
+	else {
+		m_decompositions.setDirectory(std::nullopt);
+	}
 
-		// get the scores for the glyph
-		auto scores = this->getScoresForGlyph(glyphVector, config);
+	auto const fontHash = this->getFontHash(config.fontPath);
+	// only the settings the placements depend on, so equivalent configs share entries
+	bool const incremental = config.incrementalScoring && config.pyramidFactor <= 1;
+	auto const placementBatch = incremental ? 1 : std::max(config.placementBatch, 1);
+	auto decompositionKey = [&](char32_t codepoint) {
+		return DecompositionKey{
+			fontHash, config.fontSize, codepoint, m_kernelHash, config.minScore, config.negativeScore,
+			config.objectsPerGlyph, int32_t(config.precision), int32_t(config.rasterBackend),
+			std::max(config.pyramidFactor, 1), config.pyramidFactor > 1 ? config.pyramidCandidates : 0,
+			incremental, placementBatch, placementBatch > 1 ? config.batchOverlap : 0.0,
+			config.optimizeObjects ? config.objectTolerance : -1.0
+		};
+	};
 
-		log::debug("Calculated {} convolution scores", scores.size());
+	std::map<char32_t, GlyphBitmap const*> bitmaps;
+	for (auto const& glyph : glyphs) {
+		bitmaps[glyph.codepoint] = glyph.bitmap.get();
+	}
 
-		// add the scores to the map
-		scoreMap[codepoint] = scores;
+	// where every occurrence of a glyph goes, each placed score becomes an object at all of them
+	std::map<char32_t, std::vector<sf::Vector2i>> origins;
+	for (size_t i = 0; i < text.size(); ++i) {
+		origins[text[i]].push_back(glyphOrigin(cursors[i], *bitmaps[text[i]], config));
 	}
 
-	log::debug("Creating objects");
+	auto emit = [&](char32_t codepoint, ConvolutionScore const& score) {
+		for (auto origin : origins.at(codepoint)) {
+			control.object(makeObject(score, origin, config));
+		}
+	};
 
-	// create the text 
-	sf::Text textObject;
-	textObject.setFont(font);
-	textObject.setCharacterSize(config.fontSize);
-	textObject.setFillColor(sf::Color::White);
-	textObject.setString(sf::String::fromUtf32(text.begin(), text.end()));
+	// glyphs decomposed before come straight from the cache
+	std::vector<GlyphVector2D*> glyphOrder;
+	for (auto& [codepoint, glyphVector] : glyphVectors) {
+		if (config.cacheDecompositions) {
+			if (auto scores = m_decompositions.find(decompositionKey(codepoint))) {
+				if (control.object) {
+					for (auto const& score : *scores) {
+						emit(codepoint, score);
+					}
+				}
+				scoreMap[codepoint] = std::move(*scores);
+				continue;
+			}
+		}
+		glyphOrder.push_back(&glyphVector);
+	}
 
-	log::debug("Created text object");
+	log::debug("Found {} cached decompositions", glyphVectors.size() - glyphOrder.size());
 
-	// create the objects
-	std::vector<CreatedObject> ret;
-	for (usize_t i = 0; i < text.size(); ++i) {
-		auto c = text[i];
-		auto& scores = scoreMap[c];
+	std::atomic<size_t> finishedGlyphs = glyphVectors.size() - glyphOrder.size();
+	if (control.progress) {
+		control.progress(finishedGlyphs, glyphVectors.size());
+	}
 
-		auto cursor = textObject.findCharacterPos(i);
+	// a glyph's share of the budget grows with its pixels and how often the text uses it
+	std::map<char32_t, size_t> glyphPixels;
+	for (auto const& [codepoint, glyphVector] : glyphVectors) {
+		glyphPixels[codepoint] = countPositive(glyphVector);
+	}
+	std::optional<TimeBudget> budget;
+	if (budgetEnd) {
+		size_t weight = 0;
+		for (auto glyphVector : glyphOrder) {
+			weight += glyphPixels[glyphVector->codepoint] * origins[glyphVector->codepoint].size();
+		}
+		budget.emplace(*budgetEnd, weight);
+	}
 
-		for (auto& score : scores) {
-			auto& kernel = config.kernels[score.kernelId];
-			// create the object
-			CreatedObject object;
-			// TODO: config.anchor
-			object.x = config.positionX + kernel.offsetX + double(cursor.x + score.x) / 2; // (60x60)
-			object.y = config.positionY + kernel.offsetY - double(cursor.y + score.y) / 2;
-			object.objectId = kernel.objectId;
-			object.scale = kernel.scale;
-			object.rotation = kernel.rotation;
+	// every glyph is decomposed on its own, kernel scoring nests inside
+	std::vector<std::vector<ConvolutionScore>> glyphScores(glyphOrder.size());
+	std::vector<size_t> placedCounts(glyphOrder.size());
+	// glyphs cut short must not be cached
+	std::vector<uint8_t> interrupted(glyphOrder.size(), 0);
+	tbb::parallel_for(size_t(0), glyphOrder.size(), [&](size_t index) {
+		auto& glyphVector = *glyphOrder[index];
+		auto codepoint = glyphVector.codepoint;
+		std::vector<double> original;
+		if (config.optimizeObjects) {
+			original = glyphVector.data;
+		}
+
+		PlacedCallback placed;
+		if (control.object && !config.optimizeObjects) {
+			placed = [&](ConvolutionScore const& score) {
+				emit(codepoint, score);
+			};
+		}
+		auto const glyphControl = control.until(
+			budget ? std::optional(budget->start(glyphPixels.at(codepoint) * origins.at(codepoint).size()))
+				: std::nullopt
+		);
+		glyphScores[index] = m_decomposer.decompose(
+			glyphVector, config, config.objectsPerGlyph, glyphControl, placed
+		);
+		interrupted[index] = glyphControl.interrupted;
+		placedCounts[index] = glyphScores[index].size();
+
+		if (config.optimizeObjects) {
+			// out of time the greedy objects are kept as they are
+			if (!glyphControl.stopped()) {
+				glyphScores[index] = m_reducer->reduce(
+					original.data(), glyphVector.width, glyphVector.height, config.negativeScore, glyphScores[index],
+					config.objectTolerance, config.minScore
+				);
+				glyphVector.data = std::move(original);
+				coverPixels(glyphVector, glyphScores[index], config);
+			}
+			if (control.object) {
+				for (auto const& score : glyphScores[index]) {
+					emit(codepoint, score);
+				}
+			}
+		}
+
+		auto finished = ++finishedGlyphs;
+		if (control.progress) {
+			control.progress(finished, glyphVectors.size());
+		}
+	});
+
+	// merge in codepoint order so the result does not depend on scheduling
+	std::map<char32_t, size_t> placedObjects;
+	for (size_t index = 0; index < glyphOrder.size(); ++index) {
+		log::debug("Calculated {} convolution scores", glyphScores[index].size());
+		if (placedCounts[index] != glyphScores[index].size()) {
+			log::debug("Optimized {} objects to {}", placedCounts[index], glyphScores[index].size());
+		}
 
-			// add the object to the list
-			ret.push_back(object);
+		auto codepoint = glyphOrder[index]->codepoint;
+		placedObjects[codepoint] = placedCounts[index];
+		if (config.cacheDecompositions && !interrupted[index]) {
+			m_decompositions.insert(decompositionKey(codepoint), glyphScores[index]);
 		}
+		scoreMap[codepoint] = std::move(glyphScores[index]);
 	}
 
-	log::debug("Created {} objects", ret.size());
+	this->savePlans();
+
+	// decomposed glyphs were left with what their objects did not cover, cached ones are covered now
+	size_t totalPixels = 0, coveredPixels = 0;
+	for (auto& [codepoint, glyphVector] : glyphVectors) {
+		if (std::find(glyphOrder.begin(), glyphOrder.end(), &glyphVector) == glyphOrder.end()) {
+			coverPixels(glyphVector, scoreMap[codepoint], config);
+		}
+		auto const count = origins[codepoint].size();
+		totalPixels += glyphPixels[codepoint] * count;
+		coveredPixels += (glyphPixels[codepoint] - countPositive(glyphVector)) * count;
+		auto const placed = placedObjects.find(codepoint);
+		report.placedObjects += (placed != placedObjects.end() ? placed->second : scoreMap[codepoint].size()) * count;
+	}
+	report.coverage = totalPixels > 0 ? double(coveredPixels) / double(totalPixels) : 1.0;
+
+	log::debug("Creating objects");
+
+	// create the objects
+	std::vector<CreatedObject> ret;
+	for (size_t i = 0; i < text.size(); ++i) {
+		auto c = text[i];
+		addObjects(ret, scoreMap[c], glyphOrigin(cursors[i], *bitmaps[c], config), config);
+	}
+
+	log::debug("Created {} objects, {} coverage", ret.size(), report.coverage);
 
 	// return the objects
 	return ret;
@@ -489,5 +867,116 @@ Generator* Generator::get() {
 std::vector<CreatedObject> Generator::create(
 	std::u32string const& text, GeneratorConfig const& config
 ) {
-	return m_impl->create(text, config);
+	GenerationProgress report;
+	return this->create(text, config, report);
+}
+
+std::vector<CreatedObject> Generator::create(
+	std::u32string const& text, GeneratorConfig const& config, GenerationProgress& report
+) {
+	auto ret = m_impl->create(text, config, GenerationControl{}, report);
+	report.objects = ret.size();
+	return ret;
+}
+
+struct GenerationTask::State {
+	std::mutex mutex;
+	std::condition_variable stopped;
+	std::atomic<bool> cancelled = false;
+	bool done = false;
+	// placed but not polled yet
+	std::vector<CreatedObject> pending;
+	std::vector<CreatedObject> objects;
+	GenerationProgress progress;
+};
+
+GenerationTask::GenerationTask(std::shared_ptr<State> state) :
+	m_state(std::move(state)) {}
+
+void GenerationTask::cancel() {
+	m_state->cancelled = true;
+}
+
+bool GenerationTask::done() const {
+	std::lock_guard lock(m_state->mutex);
+	return m_state->done;
+}
+
+std::vector<CreatedObject> GenerationTask::poll() {
+	std::vector<CreatedObject> ret;
+	std::lock_guard lock(m_state->mutex);
+	ret.swap(m_state->pending);
+	return ret;
+}
+
+GenerationProgress GenerationTask::progress() const {
+	std::lock_guard lock(m_state->mutex);
+	return m_state->progress;
+}
+
+std::vector<CreatedObject> const& GenerationTask::wait() const {
+	std::unique_lock lock(m_state->mutex);
+	m_state->stopped.wait(lock, [&] {
+		return m_state->done;
+	});
+	// never written again once done
+	return m_state->objects;
+}
+
+GenerationTask Generator::createAsync(
+	std::u32string text, std::shared_ptr<GeneratorConfig const> config, GenerationCallbacks callbacks,
+	std::optional<std::chrono::steady_clock::time_point> deadline
+) {
+	auto state = std::make_shared<GenerationTask::State>();
+
+	auto job = [this, state, text = std::move(text), config = std::move(config),
+		callbacks = std::move(callbacks), deadline] {
+		GenerationControl control;
+		control.cancelled = &state->cancelled;
+		control.deadline = deadline;
+		control.object = [&](CreatedObject const& object) {
+			{
+				std::lock_guard lock(state->mutex);
+				state->pending.push_back(object);
+				++state->progress.objects;
+			}
+			if (callbacks.object) {
+				callbacks.object(object);
+			}
+		};
+		control.progress = [&](size_t finished, size_t total) {
+			GenerationProgress progress;
+			{
+				std::lock_guard lock(state->mutex);
+				// glyphs finishing on other workers may report out of order
+				state->progress.finished = std::max(state->progress.finished, finished);
+				state->progress.total = total;
+				progress = state->progress;
+			}
+			if (callbacks.progress) {
+				callbacks.progress(progress);
+			}
+		};
+
+		GenerationProgress report;
+		// create holds its mutex while waiting on parallel loops, a worker picking up the next queued
+		// generation in such a wait would block on that mutex for good
+		auto objects = tbb::this_task_arena::isolate([&] {
+			return m_impl->create(text, *config, control, report);
+		});
+
+		{
+			std::lock_guard lock(state->mutex);
+			state->objects = std::move(objects);
+			state->progress.coverage = report.coverage;
+			state->progress.placedObjects = report.placedObjects;
+			state->done = true;
+		}
+		state->stopped.notify_all();
+	};
+
+	m_impl->m_arena.execute([&] {
+		m_impl->m_tasks.run(std::move(job));
+	});
+	return GenerationTask(state);
 }
\ No newline at end of file
@@ -1,5 +1,11 @@
 #include <GeneratorNew.hpp>
+#include <BinaryCorrelation.hpp>
+#include <FontCache.hpp>
+#include <IntegralImage.hpp>
+#include <KernelBank.hpp>
+#include <chrono>
 #include <iostream>
+#include <optional>
 #include <SFML/Graphics.hpp>
 
 using namespace tulip::text;
@@ -10,32 +16,95 @@ GeneratorNew::~GeneratorNew() = default;
 
 class GeneratorNew::Impl {
 public:
-    std::vector<sf::Image> m_kernels;
+    // row-major width x height, 1 where set, read in place from a bank or from m_ownedMasks
+    struct KernelMask {
+        uint8_t const* data;
+        int width;
+        int height;
+    };
+
+    std::vector<KernelMask> m_kernels;
     std::vector<bool> m_offset;
-
-    int m_width;
-    int m_height;
-
-    sf::Image m_glyphImage;
-    sf::Image m_edgeImage;
-    sf::Image m_filledImage;
-    sf::Image m_removedImage;
-    sf::Image m_kernelImage;
+    // masks of kernels added from images, bank kernels stay in their bank
+    std::vector<std::vector<uint8_t>> m_ownedMasks;
+
+    int m_width = 0;
+    int m_height = 0;
+
+    // row-major m_width x m_height masks, 1 where set
+    std::vector<uint8_t> m_glyph;
+    std::vector<uint8_t> m_edge;
+    std::vector<uint8_t> m_filled;
+    std::vector<uint8_t> m_removed;
+    std::vector<uint8_t> m_placed;
+
+    // only built when the viewer asks for them
+    mutable sf::Image m_glyphImage;
+    mutable sf::Image m_edgeImage;
+    mutable sf::Image m_filledImage;
+    mutable sf::Image m_removedImage;
+    mutable sf::Image m_kernelImage;
+    mutable sf::Image m_kernelMaskImage;
+
+    sf::Image const& toImage(uint8_t const* mask, int width, int height, sf::Image& image) const;
+    sf::Image const& toImage(std::vector<uint8_t> const& mask, sf::Image& image) const;
 
     double bestScore = 0;
     int bestKernel = 0;
     int bestX = 0;
     int bestY = 0;
 
-    Matrix<double> m_input;
-    Matrix<double> m_kernel;
-    Matrix<double> m_output;
-    Convolution m_convolution;
-
-    Impl() : m_input(400, 400), m_kernel(400, 400), m_output(400, 400), m_convolution(m_input, m_kernel, m_output) {}
-
-    void init(char32_t glyph);
+    // transforms sized for the current glyph and largest kernel
+    struct Workspace {
+        Matrix<double> input;
+        Matrix<double> kernel;
+        Matrix<double> output;
+        Convolution<double> convolution;
+        KernelSpectrumBank<double> edgeSpectrum;
+        KernelSpectrumBank<double> spectra;
+        BatchedCorrelation<double> correlation;
+        std::vector<BitMatrix> masks;
+        std::vector<std::optional<KernelRectangle>> rectangles;
+
+        Workspace(size_t width, size_t height) :
+            input(width, height),
+            kernel(width, height),
+            output(width, height),
+            convolution(input, kernel, output),
+            edgeSpectrum(width, height),
+            spectra(width, height),
+            correlation(input, spectra) {}
+    };
+
+    std::unique_ptr<Workspace> m_workspace;
+
+    Workspace& workspace();
+
+    GeneratorStageTimes m_times;
+
+    // a step runs these in order, each stage only reads what the earlier ones wrote
+    void detectEdges(Workspace& workspace);
+    BinaryField buildField(Workspace& workspace);
+    // hands every kernel's full correlation map to scan, in kernel order
+    template <class Scan>
+    void correlate(Workspace& workspace, BinaryField const& field, Scan&& scan);
+    void select(size_t kernel, Matrix<double> const& map);
+    void place();
+
+    RasterBackend m_rasterBackend = RasterBackend::Sfml;
+
+    // the sprite sheet last read back from the gpu, kernel sprites mostly share one
+    sf::Texture const* m_sheetTexture = nullptr;
+    unsigned m_sheetHandle = 0;
+    sf::Image m_sheet;
+
+    sf::Image const& getSheet(sf::Texture const& texture);
+
+    bool init(char32_t glyph);
     void addKernel(sf::Sprite& kernel, double scale);
+    void addKernel(sf::Image const& image, sf::Transform const& transform, double scale);
+    void addKernelImage(sf::Image image, double scale);
+    void addKernels(KernelBank const& bank);
     void step(int steps);
 
     sf::Image const& getGlyph() const;
@@ -46,207 +115,431 @@ public:
 };
 
 sf::Image const& GeneratorNew::getKernel2(int index) const {
-    return m_impl->m_kernels[index];
+    auto const& kernel = m_impl->m_kernels[index];
+    return m_impl->toImage(kernel.data, kernel.width, kernel.height, m_impl->m_kernelMaskImage);
 }
 
-void GeneratorNew::Impl::init(char32_t glyph) {
-    sf::Font font;
-    font.loadFromFile("/Users/student/Desktop/NotoSansJP-Regular.ttf");
-
-    auto glyph2 = font.getGlyph(glyph, 200, false);
+GeneratorStageTimes const& GeneratorNew::getTimes() const {
+    return m_impl->m_times;
+}
 
-    sf::Image fontImage = font.getTexture(200).copyToImage();
+bool GeneratorNew::Impl::init(char32_t glyph) {
+    auto bitmaps = FontCache::get().glyphs(
+        "/Users/student/Desktop/NotoSansJP-Regular.ttf", 200, { glyph }, m_rasterBackend
+    );
+
+    // nothing of the previous glyph survives, a failed init leaves an empty one
+    m_width = 0;
+    m_height = 0;
+    m_glyph.clear();
+    m_edge.clear();
+    m_filled.clear();
+    m_placed.clear();
+    m_removed.clear();
+    bestScore = 0;
+    bestKernel = 0;
+    bestX = 0;
+    bestY = 0;
+
+    if (bitmaps.empty()) {
+        return false;
+    }
+    auto const& bitmap = *bitmaps[0];
 
-    m_width = glyph2.textureRect.width;
-    m_height = glyph2.textureRect.height;
+    m_width = bitmap.width;
+    m_height = bitmap.height;
 
     // std::cout << m_width << " " << m_height << std::endl;
 
-    m_glyphImage.create(m_width, m_height, sf::Color::Black);
-    m_glyphImage.copy(fontImage, 0, 0, glyph2.textureRect);
-    for (int x = 0; x < m_width; ++x) {
-        for (int y = 0; y < m_height; ++y) {
-            auto color = m_glyphImage.getPixel(x, y);
-            if (color.a > 127) {
-                m_glyphImage.setPixel(x, y, sf::Color::White);
-            }
-            else {
-                m_glyphImage.setPixel(x, y, sf::Color::Black);
-            }
-        }
+    auto const size = size_t(m_width) * m_height;
+    m_glyph.assign(size, 0);
+    for (size_t i = 0; i < size; ++i) {
+        m_glyph[i] = bitmap.alpha[i] > 127;
     }
 
-    m_edgeImage.create(m_width, m_height, sf::Color::Black);
+    m_edge.assign(size, 0);
+    m_filled.assign(size, 0);
+    m_placed.assign(size, 0);
+    m_removed = m_glyph;
 
-    m_filledImage.create(m_width, m_height, sf::Color::Black);
+    return true;
+}
 
-    m_kernelImage.create(m_width, m_height, sf::Color::Black);
+namespace {
+    // nearest texel of source within rect under every destination pixel centre,
+    // what drawing a sprite over black does without a render target
+    sf::Image resample(
+        sf::Image const& source, sf::IntRect const& rect, sf::Transform const& transform, int width, int height
+    ) {
+        sf::Image ret;
+        ret.create(width, height, sf::Color::Black);
+
+        auto const inverse = transform.getInverse();
+        auto const pixels = source.getPixelsPtr();
+        auto const sourceWidth = int(source.getSize().x);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                auto const local = inverse.transformPoint(x + 0.5f, y + 0.5f);
+                auto const u = int(std::floor(local.x));
+                auto const v = int(std::floor(local.y));
+                if (u < 0 || v < 0 || u >= rect.width || v >= rect.height) {
+                    continue;
+                }
 
-    m_removedImage.create(m_width, m_height, sf::Color::Black);
-    m_removedImage.copy(m_glyphImage, 0, 0, { 0, 0, m_width, m_height });
+                // alpha blended over black
+                auto const texel = pixels + (size_t(rect.top + v) * sourceWidth + rect.left + u) * 4;
+                auto const alpha = texel[3];
+                ret.setPixel(x, y, sf::Color(
+                    texel[0] * alpha / 255, texel[1] * alpha / 255, texel[2] * alpha / 255
+                ));
+            }
+        }
+        return ret;
+    }
 }
 
 void GeneratorNew::Impl::addKernel(sf::Sprite& kernel, double scale) {
     int width = std::round(120 * scale); 
     int height = std::round(120 * scale);
 
+    if (m_rasterBackend == RasterBackend::FreeType) {
+        // only the sprite sheet comes back from the gpu, once for every sprite on it, nothing is drawn
+        auto const& source = this->getSheet(*kernel.getTexture());
+        this->addKernelImage(
+            resample(source, kernel.getTextureRect(), kernel.getTransform(), width, height), scale
+        );
+        return;
+    }
+
     sf::RenderTexture renderTexture;
     renderTexture.create( width, height );
     renderTexture.clear( sf::Color::Black );
     renderTexture.draw( kernel );
     renderTexture.display();
 
-    sf::Image image = renderTexture.getTexture().copyToImage();
+    this->addKernelImage(renderTexture.getTexture().copyToImage(), scale);
+}
+
+sf::Image const& GeneratorNew::Impl::getSheet(sf::Texture const& texture) {
+    // a texture destroyed and recreated in its place gets a new handle or size
+    if (m_sheetTexture != &texture || m_sheetHandle != texture.getNativeHandle() ||
+        m_sheet.getSize() != texture.getSize()) {
+        m_sheet = texture.copyToImage();
+        m_sheetTexture = &texture;
+        m_sheetHandle = texture.getNativeHandle();
+    }
+    return m_sheet;
+}
+
+void GeneratorNew::Impl::addKernel(sf::Image const& image, sf::Transform const& transform, double scale) {
+    int width = std::round(120 * scale);
+    int height = std::round(120 * scale);
+
+    auto const size = image.getSize();
+    this->addKernelImage(
+        resample(image, sf::IntRect(0, 0, size.x, size.y), transform, width, height), scale
+    );
+}
+
+void GeneratorNew::Impl::addKernelImage(sf::Image image, double scale) {
+    auto const size = image.getSize();
+
+    auto& mask = m_ownedMasks.emplace_back(size.x * size.y, 0);
+    auto pixels = image.getPixelsPtr();
+    for (size_t i = 0; i < mask.size(); ++i) {
+        // red of the rgba pixel
+        mask[i] = pixels[i * 4] > 127;
+    }
 
-    m_kernels.push_back(image);
+    m_kernels.push_back({ mask.data(), int(size.x), int(size.y) });
     m_offset.push_back(int(std::round(scale * 60)) % 2 == 1);
 }
 
-void GeneratorNew::Impl::step(int steps) {
-    for (int w = 0; w < steps; ++w) {
-        bestScore = 0;
+void GeneratorNew::Impl::addKernels(KernelBank const& bank) {
+    for (size_t index = 0; index < bank.size(); ++index) {
+        auto const& kernel = bank[index];
 
-        m_input.zero();
-        for (int x = 0; x < m_width; ++x) {
-            for (int y = 0; y < m_height; ++y) {
-                auto color = m_removedImage.getPixel(x, y);
-                if (color.r > 127) {
-                    m_input(x, y) = 1;
-                }
-            }
+        // bank masks are cropped to their pixels, there is no centring to correct
+        m_kernels.push_back({ bank.mask(index), kernel.width, kernel.height });
+        m_offset.push_back(false);
+    }
+}
+
+GeneratorNew::Impl::Workspace& GeneratorNew::Impl::workspace() {
+    // laplacian used for edge detection
+    int maxKernelWidth = 5;
+    int maxKernelHeight = 5;
+    for (auto const& kernel : m_kernels) {
+        maxKernelWidth = std::max(maxKernelWidth, kernel.width);
+        maxKernelHeight = std::max(maxKernelHeight, kernel.height);
+    }
+
+    auto width = fftSize(m_width + maxKernelWidth - 1);
+    auto height = fftSize(m_height + maxKernelHeight - 1);
+
+    if (m_workspace && m_workspace->input.width == width && m_workspace->input.height == height &&
+        m_workspace->spectra.size() == m_kernels.size()) {
+        return *m_workspace;
+    }
+
+    m_workspace = std::make_unique<Workspace>(width, height);
+
+    std::vector<double> edge(5 * 5, 0);
+    for (int x = 1; x <= 3; ++x) {
+        for (int y = 1; y <= 3; ++y) {
+            edge[y * 5 + x] = -1;
         }
+    }
+    edge[0 * 5 + 2] = -1;
+    edge[2 * 5 + 0] = -1;
+    edge[2 * 5 + 2] = 12;
+    edge[2 * 5 + 4] = -1;
+    edge[4 * 5 + 2] = -1;
+    m_workspace->edgeSpectrum.add(edge.data(), 5, 5);
+
+    // the transforms take weights, the masks are widened one kernel at a time
+    std::vector<double> values;
+    for (auto const& kernel : m_kernels) {
+        values.assign(kernel.data, kernel.data + size_t(kernel.width) * kernel.height);
+        m_workspace->spectra.add(values.data(), kernel.width, kernel.height);
+        m_workspace->masks.push_back(BitMatrix::fromValues(values.data(), kernel.width, kernel.height));
+        m_workspace->rectangles.push_back(findRectangle(values.data(), kernel.width, kernel.height));
+    }
 
-        m_kernel.zero();
-        for (int x = 1; x <= 3; ++x) {
-            for (int y = 1; y <= 3; ++y) {
-                m_kernel(x, y) = -1;
-            }
+    return *m_workspace;
+}
+
+void GeneratorNew::Impl::detectEdges(Workspace& workspace) {
+    auto& input = workspace.input;
+    auto& output = workspace.output;
+
+    input.zero();
+    for (int y = 0; y < m_height; ++y) {
+        for (int x = 0; x < m_width; ++x) {
+            input(x, y) = m_removed[y * m_width + x];
         }
-        m_kernel(2, 0) = -1;
-        m_kernel(0, 2) = -1;
-        m_kernel(2, 2) = 12;
-        m_kernel(4, 2) = -1;
-        m_kernel(2, 4) = -1;
+    }
 
-        m_convolution.execute();
+    workspace.convolution.execute(workspace.edgeSpectrum[0]);
 
+    for (int y = 0; y < m_height; ++y) {
         for (int x = 0; x < m_width; ++x) {
-            for (int y = 0; y < m_height; ++y) {
-                if (m_output(x+1, y+1) > 0.5) {
-                    m_edgeImage.setPixel(x, y, sf::Color::White);
-                } else {
-                    m_edgeImage.setPixel(x, y, sf::Color::Black);
-                }
-            }
+            m_edge[y * m_width + x] = output(x+1, y+1) > 0.5;
         }
+    }
+}
 
-        for (int i = 0; i < m_kernels.size(); ++i) {
-            auto& kernel = m_kernels[i];
-            auto kernelWidth = kernel.getSize().x;
-            auto kernelHeight = kernel.getSize().y;
-            
-            m_input.fill(-4);
-            for (int x = 0; x < m_width; ++x) {
-                for (int y = 0; y < m_height; ++y) {
-                    auto colorE = m_edgeImage.getPixel(x, y);
-                    auto colorG = m_glyphImage.getPixel(x, y);
-                    auto colorF = m_filledImage.getPixel(x, y);
-
-                    if (colorE.r > 0) {
-                        m_input(x, y) = 1;
-                    }
-                    else if (colorG.r > 0) {
-                        if (colorF.r > 0) {
-                            m_input(x, y) = 0; // -0.02;
-                        }
-                        else {
-                            m_input(x, y) = 0;
-                        }
-                    }
+BinaryField GeneratorNew::Impl::buildField(Workspace& workspace) {
+    auto& input = workspace.input;
 
-                }
-            }
+    // the weighted field is the same for every kernel
+    // small kernels score it from bit planes, -4 everywhere, +4 on the glyph and +1 more on edges
+    BinaryField field(m_width, m_height, -4);
+    auto covered = field.addPlane(4);
+    auto edges = field.addPlane(1);
+
+    input.fill(-4);
+    for (int y = 0; y < m_height; ++y) {
+        for (int x = 0; x < m_width; ++x) {
+            auto const index = y * m_width + x;
 
-            m_kernel.zero();
-            for (int x = 0; x < kernelWidth; ++x) {
-                for (int y = 0; y < kernelHeight; ++y) {
-                    auto color = kernel.getPixel(x, y);
-                    if (color.r > 127) {
-                        m_kernel(x, y) = 1;
-                    }
+            if (m_edge[index]) {
+                input(x, y) = 1;
+                field.planes[covered].set(x, y);
+                field.planes[edges].set(x, y);
+            }
+            else if (m_glyph[index]) {
+                field.planes[covered].set(x, y);
+                if (m_filled[index]) {
+                    input(x, y) = 0; // -0.02;
+                }
+                else {
+                    input(x, y) = 0;
                 }
             }
 
-            m_convolution.execute();
+        }
+    }
 
-            double score = 0;
-            for (int x = 0; x < m_width + kernelWidth; ++x) {
-                for (int y = 0; y < m_height + kernelHeight; ++y) {
-                    auto current = m_output(x, y);
+    return field;
+}
 
-                    if (current + 0.1 > bestScore) {
-                        bestScore = current;
-                        bestKernel = i;
-                        bestX = x - kernelWidth + 1 + m_offset[i];
-                        bestY = y - kernelHeight + 1 - m_offset[i];
-                    }
-                }
+template <class Scan>
+void GeneratorNew::Impl::correlate(Workspace& workspace, BinaryField const& field, Scan&& scan) {
+    auto& input = workspace.input;
+
+    // solid rectangles score in constant time per placement
+    IntegralImage integral(input.data, input.width, m_width, m_height, -4);
+
+    bool transformed = false;
+    for (size_t i = 0; i < m_kernels.size();) {
+        auto const& kernel = m_kernels[i];
+        if (workspace.rectangles[i] ||
+            prefersDirect(field, kernel.width, kernel.height, input.width, input.height)) {
+            Matrix<double> map(m_width + kernel.width - 1, m_height + kernel.height - 1);
+            if (workspace.rectangles[i]) {
+                integral.correlate(*workspace.rectangles[i], kernel.width, kernel.height, map);
             }
+            else {
+                correlateDirect(field, workspace.masks[i], 1.0, map);
+            }
+            scan(i, map);
+            ++i;
+            continue;
         }
 
-        std::cout << bestKernel << " " << bestScore << " " << bestX << " " << bestY << std::endl;
+        // runs of large kernels still share the batched inverse transforms
+        auto end = i + 1;
+        while (end < m_kernels.size() && end - i < workspace.correlation.batchSize) {
+            auto const& next = m_kernels[end];
+            if (workspace.rectangles[end] ||
+                prefersDirect(field, next.width, next.height, input.width, input.height)) {
+                break;
+            }
+            ++end;
+        }
 
-        auto& kernel = m_kernels[bestKernel];
-        auto kernelWidth = kernel.getSize().x;
-        auto kernelHeight = kernel.getSize().y;
+        if (!transformed) {
+            workspace.correlation.transform();
+            transformed = true;
+        }
+        std::vector<Matrix<double>> maps;
+        maps.reserve(end - i);
+        for (auto kernel = i; kernel < end; ++kernel) {
+            auto const& next = m_kernels[kernel];
+            maps.emplace_back(m_width + next.width - 1, m_height + next.height - 1);
+        }
+        workspace.correlation.correlate(workspace.correlation.inputResult, i, end, maps.data());
+        for (auto kernel = i; kernel < end; ++kernel) {
+            scan(kernel, maps[kernel - i]);
+        }
+        i = end;
+    }
+}
 
-        for (int x = 0; x < m_width; ++x) {
-            for (int y = 0; y < m_height; ++y) {
-                m_kernelImage.setPixel(x, y, sf::Color::Black);
+void GeneratorNew::Impl::select(size_t kernel, Matrix<double> const& map) {
+    auto const& mask = m_kernels[kernel];
+
+    // the running best carries over between kernels, every position within 0.1 of it takes over,
+    // so the last of a near tie wins, scanning column by column
+    for (size_t x = 0; x < map.width; ++x) {
+        for (size_t y = 0; y < map.height; ++y) {
+            auto const current = map(x, y);
+
+            if (current + 0.1 > bestScore) {
+                bestScore = current;
+                bestKernel = int(kernel);
+                bestX = int(x) - mask.width + 1 + m_offset[kernel];
+                bestY = int(y) - mask.height + 1 - m_offset[kernel];
             }
         }
+    }
+}
 
+void GeneratorNew::Impl::place() {
+    auto const mask = m_kernels[bestKernel].data;
+    int kernelWidth = m_kernels[bestKernel].width;
+    int kernelHeight = m_kernels[bestKernel].height;
+
+    std::fill(m_placed.begin(), m_placed.end(), 0);
+
+    for (int y = 0; y < kernelHeight; ++y) {
         for (int x = 0; x < kernelWidth; ++x) {
-            for (int y = 0; y < kernelHeight; ++y) {
-                auto color = kernel.getPixel(x, y);
-                if (bestX + x < 0 || bestX + x >= m_width || bestY + y < 0 || bestY + y >= m_height) {
-                    continue;
-                }
-                if (color.r > 127) {
-                    m_kernelImage.setPixel(bestX + x, bestY + y, sf::Color::White);
-                    m_removedImage.setPixel(bestX + x, bestY + y, sf::Color::Black);
-                    m_filledImage.setPixel(bestX + x, bestY + y, sf::Color::White);
-                }
+            if (bestX + x < 0 || bestX + x >= m_width || bestY + y < 0 || bestY + y >= m_height) {
+                continue;
+            }
+            if (mask[y * kernelWidth + x] > 0) {
+                auto const index = (bestY + y) * m_width + bestX + x;
+                m_placed[index] = 1;
+                m_removed[index] = 0;
+                m_filled[index] = 1;
             }
         }
+    }
+}
+
+void GeneratorNew::Impl::step(int steps) {
+    auto& workspace = this->workspace();
+
+    auto timed = [](double& total, auto&& stage) {
+        auto start = std::chrono::steady_clock::now();
+        stage();
+        total += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    for (int w = 0; w < steps; ++w) {
+        std::optional<BinaryField> field;
 
+        timed(m_times.edges, [&] { this->detectEdges(workspace); });
+        timed(m_times.field, [&] { field.emplace(this->buildField(workspace)); });
+
+        // each map is scanned as soon as it is scored, the scans are not counted as correlation
+        bestScore = 0;
+        auto const selection = m_times.selection;
+        timed(m_times.correlation, [&] {
+            this->correlate(workspace, *field, [&](size_t kernel, Matrix<double> const& map) {
+                timed(m_times.selection, [&] { this->select(kernel, map); });
+            });
+        });
+        m_times.correlation -= m_times.selection - selection;
+
+        timed(m_times.placement, [&] { this->place(); });
     }
 }
 
+sf::Image const& GeneratorNew::Impl::toImage(uint8_t const* mask, int width, int height, sf::Image& image) const {
+    auto const size = size_t(width) * height;
+    std::vector<sf::Uint8> pixels(size * 4, 255);
+    for (size_t i = 0; i < size; ++i) {
+        auto const value = mask[i] ? 255 : 0;
+        pixels[i * 4 + 0] = value;
+        pixels[i * 4 + 1] = value;
+        pixels[i * 4 + 2] = value;
+    }
+    image.create(width, height, pixels.data());
+    return image;
+}
+
+sf::Image const& GeneratorNew::Impl::toImage(std::vector<uint8_t> const& mask, sf::Image& image) const {
+    return this->toImage(mask.data(), m_width, m_height, image);
+}
+
 sf::Image const& GeneratorNew::Impl::getGlyph() const {
-    return m_glyphImage;
+    return this->toImage(m_glyph, m_glyphImage);
 }
 sf::Image const& GeneratorNew::Impl::getEdge() const {
-    return m_edgeImage;
+    return this->toImage(m_edge, m_edgeImage);
 }
 sf::Image const& GeneratorNew::Impl::getFilled() const {
-    return m_filledImage;
+    return this->toImage(m_filled, m_filledImage);
 }
 sf::Image const& GeneratorNew::Impl::getRemoved() const {
-    return m_removedImage;
+    return this->toImage(m_removed, m_removedImage);
 }
 sf::Image const& GeneratorNew::Impl::getKernel() const {
-    return m_kernelImage;
+    return this->toImage(m_placed, m_kernelImage);
 }
 
-void GeneratorNew::init(char32_t glyph) {
-    m_impl->init(glyph);
+bool GeneratorNew::init(char32_t glyph) {
+    return m_impl->init(glyph);
+}
+
+void GeneratorNew::setRasterBackend(RasterBackend backend) {
+    m_impl->m_rasterBackend = backend;
 }
 
 void GeneratorNew::addKernel(sf::Sprite& kernel, double scale) {
     m_impl->addKernel(kernel, scale);
 }
 
+void GeneratorNew::addKernel(sf::Image const& image, sf::Transform const& transform, double scale) {
+    m_impl->addKernel(image, transform, scale);
+}
+
+void GeneratorNew::addKernels(KernelBank const& bank) {
+    m_impl->addKernels(bank);
+}
+
 void GeneratorNew::step(int steps) {
     m_impl->step(steps);
 }
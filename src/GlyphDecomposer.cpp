@@ -0,0 +1,604 @@
+#include <GlyphDecomposer.hpp>
+#include <fftw3.h>
+
+#include <oneapi/tbb/blocked_range.h>
+#include <oneapi/tbb/parallel_for.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <CorrelationMaps.hpp>
+#include <PlacementEngine.hpp>
+#include <Pyramid.hpp>
+
+using namespace tulip::text;
+
+namespace tbb = oneapi::tbb;
+
+template <class Message>
+void GlyphDecomposer::log(Message&& message) const {
+	if (m_log) {
+		m_log(message());
+	}
+}
+
+void GlyphDecomposer::setKernels(std::vector<ObjectKernel> const& kernels) {
+	std::lock_guard lock(m_spectraMutex);
+	std::get<SpectraMap<double>>(m_kernelSpectra).clear();
+	std::get<SpectraMap<float>>(m_kernelSpectra).clear();
+
+	m_rectangles.clear();
+	for (auto const& kernel : kernels) {
+		m_rectangles.push_back(findRectangle(kernel.data.data(), kernel.width, kernel.height));
+	}
+}
+
+void GlyphDecomposer::setLog(std::function<void(std::string const&)> log) {
+	m_log = std::move(log);
+}
+
+template <class Real>
+KernelSpectra<Real>& GlyphDecomposer::getKernelSpectra(
+	size_t width, size_t height, size_t level, GeneratorConfig const& config
+) {
+	std::lock_guard lock(m_spectraMutex);
+
+	auto& kernelSpectra = std::get<SpectraMap<Real>>(m_kernelSpectra);
+	auto it = kernelSpectra.find({ width, height, level });
+	if (it != kernelSpectra.end()) {
+		return it->second;
+	}
+
+	this->log([&] {
+		return "Creating kernel spectra for " + std::to_string(width) + "x" + std::to_string(height) + " at level " +
+			std::to_string(level);
+	});
+
+	auto& spectra = kernelSpectra.try_emplace({ width, height, level }, width, height).first->second;
+	for (auto const& kernel : config.kernels) {
+		if (level == 1) {
+			spectra.bank.add(kernel.data.data(), kernel.width, kernel.height);
+			continue;
+		}
+		auto coarse = downsample(kernel.data.data(), kernel.width, kernel.height, level, 0.0);
+		spectra.bank.add(
+			coarse.data(), downsampledSize(kernel.width, level), downsampledSize(kernel.height, level)
+		);
+	}
+	return spectra;
+}
+
+bool GlyphDecomposer::fitsGlyph(ObjectKernel const& kernel, GlyphVector2D const& glyphVector) {
+	return size_t(kernel.width) <= glyphVector.width && size_t(kernel.height) <= glyphVector.height;
+}
+
+template <class Fft, class Rectangle>
+void GlyphDecomposer::splitKernels(size_t begin, size_t end, Fft&& fft, Rectangle&& rectangle) const {
+	for (auto id = begin; id < end;) {
+		if (m_rectangles[id]) {
+			rectangle(id);
+			++id;
+			continue;
+		}
+
+		auto runEnd = id + 1;
+		while (runEnd < end && !m_rectangles[runEnd]) {
+			++runEnd;
+		}
+		fft(id, runEnd);
+		id = runEnd;
+	}
+}
+
+template <class Real>
+std::vector<ConvolutionScore> GlyphDecomposer::getPeaks(
+	GlyphVector2D const& glyphVector, GeneratorConfig const& config, KernelSpectra<Real>& spectra,
+	BatchedCorrelation<Real> const& correlation, IntegralImage const& integral
+) {
+	std::vector<CorrelationPeak> peaks(config.kernels.size());
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>(0, config.kernels.size(), correlation.batchSize),
+		[&](tbb::blocked_range<size_t> const& range) {
+			auto& workspace = spectra.workspaces.local();
+
+			this->splitKernels(
+				range.begin(), range.end(),
+				[&](size_t begin, size_t end) {
+					workspace.correlate(
+						correlation.inputResult, begin, end, glyphVector.width, glyphVector.height, 0.1,
+						peaks.data() + begin, glyphVector.clipped
+					);
+				},
+				[&](size_t id) {
+					auto const& kernel = config.kernels[id];
+					peaks[id] = integral.peak(
+						*m_rectangles[id], kernel.width, kernel.height, 0.1, glyphVector.clipped
+					);
+				}
+			);
+		}
+	);
+
+	std::vector<ConvolutionScore> ret;
+	for (size_t id = 0; id < config.kernels.size(); ++id) {
+		if (fitsGlyph(config.kernels[id], glyphVector)) {
+			ret.push_back({ peaks[id].score, peaks[id].x, peaks[id].y, id });
+		}
+	}
+	return ret;
+}
+
+template <class Real>
+std::vector<ConvolutionScore> GlyphDecomposer::getPyramidPeaks(
+	GlyphVector2D const& glyphVector, GeneratorConfig const& config, size_t level,
+	KernelSpectra<Real>& spectra, BatchedCorrelation<Real> const& correlation
+) {
+	auto const coarseWidth = downsampledSize(glyphVector.width, level);
+	auto const coarseHeight = downsampledSize(glyphVector.height, level);
+
+	// coarse entries average level x level pixels, so the full resolution tolerance shrinks with them
+	// and equal coarse peaks go to the first one whatever the precision
+	auto const coarseTolerance = 0.1 / double(level * level);
+
+	std::vector<CorrelationPeak> peaks(config.kernels.size());
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>(0, config.kernels.size(), correlation.batchSize),
+		[&](tbb::blocked_range<size_t> const& range) {
+			spectra.workspaces.local().correlate(
+				correlation.inputResult, range.begin(), range.end(), coarseWidth, coarseHeight, coarseTolerance,
+				peaks.data() + range.begin(), glyphVector.clipped
+			);
+		}
+	);
+
+	std::vector<size_t> candidates;
+	for (size_t id = 0; id < config.kernels.size(); ++id) {
+		if (peaks[id].score > 0 && fitsGlyph(config.kernels[id], glyphVector)) {
+			candidates.push_back(id);
+		}
+	}
+	// a batch needs at least as many candidates as it takes placements
+	auto const count = std::min(
+		candidates.size(), size_t(std::max({ config.pyramidCandidates, config.placementBatch, 1 }))
+	);
+	std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), [&](size_t a, size_t b) {
+		if (peaks[a].score != peaks[b].score) {
+			return peaks[a].score > peaks[b].score;
+		}
+		return a > b;
+	});
+
+	// a coarse pixel covers level full pixels, so the window reaches one coarse pixel either way
+	auto const factor = int32_t(level);
+	std::vector<ConvolutionScore> ret(count);
+	tbb::parallel_for(size_t(0), count, [&](size_t index) {
+		auto const id = candidates[index];
+		auto const& kernel = config.kernels[id];
+		auto const centerX = peaks[id].x * factor;
+		auto const centerY = peaks[id].y * factor;
+
+		// a coarse peak inside the clipped edges leaves part of its window inside them too
+		auto const& clipped = glyphVector.clipped;
+		auto const left = clipped.left ? 0 : 1 - kernel.width;
+		auto const top = clipped.top ? 0 : 1 - kernel.height;
+		auto const right = int32_t(glyphVector.width) - (clipped.right ? kernel.width : 1);
+		auto const bottom = int32_t(glyphVector.height) - (clipped.bottom ? kernel.height : 1);
+
+		auto peak = refinePeak(
+			glyphVector.data.data(), glyphVector.width, glyphVector.height, config.negativeScore,
+			kernel.data.data(), kernel.width, kernel.height,
+			std::max(centerX - factor, left), std::max(centerY - factor, top),
+			std::min(centerX + factor, right), std::min(centerY + factor, bottom), 0.1
+		);
+		ret[index] = { peak.score, peak.x, peak.y, id };
+	});
+	return ret;
+}
+
+std::vector<ConvolutionScore> GlyphDecomposer::selectBatch(
+	std::vector<ConvolutionScore> peaks, GlyphVector2D const& glyphVector, GeneratorConfig const& config,
+	size_t size
+) {
+	// higher score first, ties to the later kernel, so a batch of one is the plain greedy choice
+	std::sort(peaks.begin(), peaks.end(), [](ConvolutionScore const& a, ConvolutionScore const& b) {
+		if (a.score != b.score) {
+			return a.score > b.score;
+		}
+		return a.kernelId > b.kernelId;
+	});
+
+	std::vector<ConvolutionScore> ret;
+	std::vector<uint8_t> covered(glyphVector.width * glyphVector.height, 0);
+	std::vector<size_t> pixels;
+	for (auto const& peak : peaks) {
+		if (ret.size() == size || peak.score < config.minScore) {
+			break;
+		}
+
+		auto const& kernel = config.kernels[peak.kernelId];
+		pixels.clear();
+		size_t overlap = 0;
+		for (int32_t y = 0; y < kernel.height; ++y) {
+			for (int32_t x = 0; x < kernel.width; ++x) {
+				auto glyphX = x + peak.x;
+				auto glyphY = y + peak.y;
+				if (kernel.data[y * kernel.width + x] <= 0.0 || glyphX < 0 || glyphY < 0 ||
+					glyphX >= int32_t(glyphVector.width) || glyphY >= int32_t(glyphVector.height)) {
+					continue;
+				}
+				auto index = size_t(glyphY) * glyphVector.width + glyphX;
+				pixels.push_back(index);
+				overlap += covered[index];
+			}
+		}
+
+		if (double(overlap) > config.batchOverlap * double(pixels.size())) {
+			continue;
+		}
+		for (auto index : pixels) {
+			covered[index] = 1;
+		}
+		ret.push_back(peak);
+	}
+	return ret;
+}
+
+std::vector<ConvolutionScore> GlyphDecomposer::decompose(
+	GlyphVector2D& glyphVector, GeneratorConfig const& config, size_t maxObjects,
+	GenerationControl const& control, PlacedCallback const& placed
+) {
+	if (config.precision == Precision::Single) {
+		return this->decomposeGlyph<float>(glyphVector, config, maxObjects, control, placed);
+	}
+	return this->decomposeGlyph<double>(glyphVector, config, maxObjects, control, placed);
+}
+
+template <class Real>
+std::vector<ConvolutionScore> GlyphDecomposer::decomposeGlyph(
+	GlyphVector2D& glyphVector, GeneratorConfig const& config, size_t maxObjects,
+	GenerationControl const& control, PlacedCallback const& placed
+) {
+	std::vector<ConvolutionScore> ret;
+
+	this->log([&] {
+		return "Calculating scores for glyph: " + std::to_string(config.kernels.size()) + " kernels";
+	});
+
+	// the pyramid search transforms the glyph and kernels downsampled by level
+	auto const level = size_t(std::max(config.pyramidFactor, 1));
+	auto const levelWidth = downsampledSize(glyphVector.width, level);
+	auto const levelHeight = downsampledSize(glyphVector.height, level);
+
+	size_t maxKernelWidth = 0, maxKernelHeight = 0;
+	for (auto const& kernel : config.kernels) {
+		maxKernelWidth = std::max(maxKernelWidth, downsampledSize(kernel.width, level));
+		maxKernelHeight = std::max(maxKernelHeight, downsampledSize(kernel.height, level));
+	}
+	// glyphs rounding up to the same size class share spectra and workspaces
+	auto width = fftSize(levelWidth + maxKernelWidth - 1);
+	auto height = fftSize(levelHeight + maxKernelHeight - 1);
+
+	auto& spectra = this->getKernelSpectra<Real>(width, height, level, config);
+	Matrix<Real> input(width, height);
+	input.fill(config.negativeScore);
+
+	// every worker correlates its share of the kernels against the shared input spectrum
+	BatchedCorrelation<Real> correlation(input, spectra.bank);
+
+	// rectangular kernels only need the integral image, so the fft can be skipped without others
+	IntegralImage integral(
+		glyphVector.data.data(), glyphVector.width, glyphVector.width, glyphVector.height, config.negativeScore
+	);
+	bool const needsTransform = level > 1 ||
+		std::any_of(m_rectangles.begin(), m_rectangles.end(), [](auto const& rectangle) {
+			return !rectangle;
+		});
+
+	std::vector<bool> active;
+	for (auto const& kernel : config.kernels) {
+		active.push_back(fitsGlyph(kernel, glyphVector));
+	}
+
+	// incremental scoring keeps the correlation map of every kernel that fits and patches it after each
+	// placement, as long as the maps of all glyphs in flight stay within incrementalMemory
+	std::optional<CorrelationMaps> maps;
+	std::optional<PlacementEngine> engine;
+	size_t mapMemory = 0;
+	// without room for the maps it still places one kernel at a time, so the result never depends on memory
+	bool const incremental = config.incrementalScoring && level == 1;
+	auto const batchSize = incremental ? size_t(1) : size_t(std::max(config.placementBatch, 1));
+	if (incremental) {
+		mapMemory = CorrelationMaps::memory(config.kernels, active, glyphVector.width, glyphVector.height);
+		if (m_mapMemory.fetch_add(mapMemory) + mapMemory <= config.incrementalMemory) {
+			maps.emplace(config.kernels, active, glyphVector.width, glyphVector.height, glyphVector.clipped);
+		}
+		else {
+			this->log([&] {
+				return "Calculating scores for glyph: no memory for " + std::to_string(mapMemory) +
+					" bytes of correlation maps";
+			});
+			m_mapMemory -= mapMemory;
+			mapMemory = 0;
+		}
+	}
+	// roughly what recomputing every map through the fft costs
+	auto const refreshCost = config.kernels.size() * width * height * size_t(std::log2(width * height) + 1);
+	bool stale = true;
+	std::vector<PixelChange> changes;
+
+	// a pass that would not end before the deadline is not started, the one before tells how long it takes
+	auto passStart = std::chrono::steady_clock::now();
+
+	// repeat for every object added to glyph
+	for (size_t objectIndex = 0; objectIndex < maxObjects;) {
+		auto const now = std::chrono::steady_clock::now();
+		if (control.stopped(now - passStart)) {
+			this->log([&] {
+				return "Calculating scores for glyph: stopped after " + std::to_string(objectIndex) + " objects";
+			});
+			control.interrupted = true;
+			break;
+		}
+		passStart = now;
+
+		if ((!maps || stale) && needsTransform) {
+			// the glyph is the same for every kernel in this step
+			if (level > 1) {
+				auto coarse = downsample(
+					glyphVector.data.data(), glyphVector.width, glyphVector.height, level, config.negativeScore
+				);
+				for (size_t y = 0; y < levelHeight; ++y) {
+					for (size_t x = 0; x < levelWidth; ++x) {
+						input(x, y) = coarse[y * levelWidth + x];
+					}
+				}
+			}
+			else {
+				for (size_t y = 0; y < glyphVector.height; ++y) {
+					for (size_t x = 0; x < glyphVector.width; ++x) {
+						input(x, y) = glyphVector.data[y * glyphVector.width + x];
+					}
+				}
+			}
+			correlation.transform();
+		}
+
+		// placements taken from this scoring pass, best first
+		std::vector<ConvolutionScore> batch;
+		if (maps) {
+			if (stale) {
+				tbb::parallel_for(
+					tbb::blocked_range<size_t>(0, config.kernels.size(), correlation.batchSize),
+					[&](tbb::blocked_range<size_t> const& range) {
+						this->splitKernels(
+							range.begin(), range.end(),
+							[&](size_t begin, size_t end) {
+								spectra.workspaces.local().correlate(
+									correlation.inputResult, begin, end, &(*maps)[begin]
+								);
+							},
+							[&](size_t id) {
+								auto const& kernel = config.kernels[id];
+								if (active[id]) {
+									integral.correlate(*m_rectangles[id], kernel.width, kernel.height, (*maps)[id]);
+								}
+							}
+						);
+					}
+				);
+				stale = false;
+			}
+			if (!engine) {
+				engine.emplace(*maps, active, 0.1);
+			}
+
+			auto candidate = engine->next(config.minScore);
+			if (!candidate) {
+				break;
+			}
+			batch.push_back({ candidate->score, candidate->x, candidate->y, candidate->kernel });
+		}
+		else if (level > 1) {
+			batch = selectBatch(
+				this->getPyramidPeaks(glyphVector, config, level, spectra, correlation), glyphVector, config,
+				batchSize
+			);
+		}
+		else {
+			batch = selectBatch(
+				this->getPeaks(glyphVector, config, spectra, correlation, integral), glyphVector, config,
+				batchSize
+			);
+		}
+
+		// break;
+
+		if (batch.empty() || batch.front().score < config.minScore) {
+			break;
+		}
+
+		for (size_t batchIndex = 0; batchIndex < batch.size() && objectIndex < maxObjects; ++batchIndex) {
+			auto bestScore = batch[batchIndex];
+			if (batchIndex > 0) {
+				// the placements before it may have taken some of its pixels
+				auto const& kernel = config.kernels[bestScore.kernelId];
+				bestScore.score = refinePeak(
+					glyphVector.data.data(), glyphVector.width, glyphVector.height, config.negativeScore,
+					kernel.data.data(), kernel.width, kernel.height, bestScore.x, bestScore.y, bestScore.x,
+					bestScore.y, 0.0
+				).score;
+				if (bestScore.score < config.minScore) {
+					continue;
+				}
+			}
+
+			this->log([&] {
+				return "Applying convolution " + std::to_string(bestScore.kernelId) + " to glyph " +
+					std::to_string(bestScore.x) + ", " + std::to_string(bestScore.y) + " scoring " +
+					std::to_string(bestScore.score);
+			});
+
+			// apply the best convolution
+			auto& kernel = config.kernels[bestScore.kernelId];
+			changes.clear();
+
+			for (size_t y = 0; y < size_t(kernel.height); ++y) {
+				for (size_t x = 0; x < size_t(kernel.width); ++x) {
+					auto glyphX = int32_t(x) + bestScore.x;
+					auto glyphY = int32_t(y) + bestScore.y;
+					if (glyphX < 0 || glyphX >= int32_t(glyphVector.width) || glyphY < 0 ||
+						glyphY >= int32_t(glyphVector.height)) {
+						continue;
+					}
+
+					auto index = y * kernel.width + x;
+					auto index2 = glyphY * glyphVector.width + glyphX;
+
+					// if kernel is positive and glyph is positive, subtract kernel from glyph
+					if (kernel.data[index] > 0.0f && glyphVector.data[index2] > 0.0f) {
+						// square the kernel because handling transparency is hard
+						// glyphVector.data[index2] -= kernel.data[index] * kernel.data[index];
+						// if (glyphVector.data[index2] <= 0.0f) {
+						// 	glyphVector.data[index2] = -1.0f;
+						// }
+						changes.push_back({ glyphX, glyphY, -glyphVector.data[index2] });
+						glyphVector.data[index2] = 0;
+					}
+				}
+			}
+
+			// for (size_t y = 0; y < height; ++y) {
+			// 	for (size_t x = 0; x < width; ++x) {
+			// 		auto index = y * width + x;
+			// 		auto input = fftwData[bestScore.kernelId].input;;
+			// 		std::cout << (input[index] < 0.1 ? '.' : '#') << ' ';
+			// 	}
+			// 	std::cout << '\n';
+			// }
+			// for (size_t i = 0; i < width; ++i) {
+			// 	std::cout << "--";
+			// }
+			// std::cout << '\n';
+			// for (size_t y = 0; y < height; ++y) {
+			// 	for (size_t x = 0; x < width; ++x) {
+			// 		auto index = y * width + x;
+			// 		auto kernelInput = fftwData[bestScore.kernelId].kernelInput;;
+			// 		std::cout << (kernelInput[index]<= 0.0 ? '.' : '#')  << ' ';
+			// 	}
+			// 	std::cout << '\n';
+			// }
+			// for (size_t i = 0; i < width; ++i) {
+			// 	std::cout << "--";
+			// }
+			// std::cout << '\n';
+			// for (size_t y = 0; y < height; ++y) {
+			// 	for (size_t x = 0; x < width; ++x) {
+			// 		auto index = y * width + x;
+			// 		auto convolutionOutput = fftwData[bestScore.kernelId].convolutionOutput;;
+			// 		auto value = (int)std::round(convolutionOutput[index]);
+
+			// 		if (value >= 10) {
+			// 			std::cout << value << ' ';
+			// 		}
+			// 		else if (value >= 0) {
+			// 			std::cout << value << "  ";
+			// 		}
+			// 		else {
+			// 			std::cout << " . ";
+			// 		}
+			// 	}
+			// 	std::cout << '\n';
+			// }
+
+			integral.update(changes);
+
+			if (maps) {
+				// patch the maps unless the placement touched so much that a refresh is cheaper
+				if (maps->updateCost(changes.size()) > refreshCost) {
+					// recomputed maps can differ from patched ones in the last bits, the engine starts over
+					stale = true;
+					engine.reset();
+				}
+				else if (!changes.empty()) {
+					int32_t left = changes[0].x, top = changes[0].y, right = left, bottom = top;
+					for (auto const& change : changes) {
+						left = std::min(left, change.x);
+						top = std::min(top, change.y);
+						right = std::max(right, change.x);
+						bottom = std::max(bottom, change.y);
+					}
+
+					tbb::parallel_for(size_t(0), maps->size(), [&](size_t id) {
+						auto const& kernel = config.kernels[id];
+						if (!active[id]) {
+							return;
+						}
+						if (!m_rectangles[id]) {
+							maps->update(id, changes);
+							return;
+						}
+
+						// rescore every placement whose footprint reaches the changed pixels
+						auto& map = (*maps)[id];
+						integral.correlate(
+							*m_rectangles[id], kernel.width, kernel.height, map, left, top,
+							std::min<size_t>(right + kernel.width, map.width),
+							std::min<size_t>(bottom + kernel.height, map.height)
+						);
+					});
+				}
+				if (engine) {
+					engine->invalidate(changes);
+				}
+			}
+
+			// add the score to the list
+			ret.push_back(bestScore);
+			if (placed) {
+				placed(bestScore);
+			}
+			++objectIndex;
+		}
+	}
+
+	if (engine) {
+		this->log([&] {
+			return "Calculated scores for glyph: " + std::to_string(engine->evaluations()) + " peak evaluations";
+		});
+	}
+	engine.reset();
+	maps.reset();
+	m_mapMemory -= mapMemory;
+
+	return ret;
+}
+
+size_t tulip::text::countPositive(GlyphVector2D const& glyphVector) {
+	return std::count_if(glyphVector.data.begin(), glyphVector.data.end(), [](double value) {
+		return value > 0.0;
+	});
+}
+
+void tulip::text::coverPixels(
+	GlyphVector2D& glyphVector, std::vector<ConvolutionScore> const& scores, GeneratorConfig const& config
+) {
+	for (auto const& score : scores) {
+		auto const& kernel = config.kernels[score.kernelId];
+		for (size_t y = 0; y < size_t(kernel.height); ++y) {
+			for (size_t x = 0; x < size_t(kernel.width); ++x) {
+				auto glyphX = int32_t(x) + score.x;
+				auto glyphY = int32_t(y) + score.y;
+				if (glyphX < 0 || glyphX >= int32_t(glyphVector.width) || glyphY < 0 ||
+					glyphY >= int32_t(glyphVector.height)) {
+					continue;
+				}
+
+				auto& value = glyphVector.data[glyphY * glyphVector.width + glyphX];
+				if (kernel.data[y * kernel.width + x] > 0.0f && value > 0.0f) {
+					value = 0;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,138 @@
+#include <IntegralImage.hpp>
+#include <algorithm>
+
+using namespace tulip::text;
+
+std::optional<KernelRectangle> tulip::text::findRectangle(double const* kernel, size_t width, size_t height) {
+	int32_t left = int32_t(width), top = int32_t(height), right = -1, bottom = -1;
+	double weight = 0.0;
+
+	for (size_t y = 0; y < height; ++y) {
+		for (size_t x = 0; x < width; ++x) {
+			auto value = kernel[y * width + x];
+			if (value == 0.0) {
+				continue;
+			}
+			if (weight != 0.0 && value != weight) {
+				return std::nullopt;
+			}
+			weight = value;
+			left = std::min(left, int32_t(x));
+			top = std::min(top, int32_t(y));
+			right = std::max(right, int32_t(x));
+			bottom = std::max(bottom, int32_t(y));
+		}
+	}
+
+	if (right < 0) {
+		return std::nullopt;
+	}
+
+	// a hole inside the bounding box means it is not solid
+	for (int32_t y = top; y <= bottom; ++y) {
+		for (int32_t x = left; x <= right; ++x) {
+			if (kernel[y * width + x] == 0.0) {
+				return std::nullopt;
+			}
+		}
+	}
+
+	return KernelRectangle{ left, top, right - left + 1, bottom - top + 1, weight };
+}
+
+IntegralImage::IntegralImage(
+	double const* values, size_t stride, size_t width, size_t height, double background
+) :
+	m_width(width),
+	m_height(height),
+	m_background(background),
+	m_values(width * height),
+	m_sums((width + 1) * (height + 1), 0.0) {
+	for (size_t y = 0; y < height; ++y) {
+		std::copy(values + y * stride, values + y * stride + width, m_values.data() + y * width);
+	}
+	this->rebuild(0);
+}
+
+void IntegralImage::rebuild(size_t firstRow) {
+	auto const stride = m_width + 1;
+
+	for (size_t y = firstRow; y < m_height; ++y) {
+		double row = 0.0;
+		for (size_t x = 0; x < m_width; ++x) {
+			row += m_values[y * m_width + x];
+			m_sums[(y + 1) * stride + x + 1] = m_sums[y * stride + x + 1] + row;
+		}
+	}
+}
+
+void IntegralImage::update(std::vector<PixelChange> const& changes) {
+	if (changes.empty()) {
+		return;
+	}
+
+	auto firstRow = m_height;
+	for (auto const& change : changes) {
+		m_values[change.y * m_width + change.x] += change.delta;
+		firstRow = std::min(firstRow, size_t(change.y));
+	}
+	this->rebuild(firstRow);
+}
+
+double IntegralImage::sum(int64_t x, int64_t y, int64_t width, int64_t height) const {
+	auto const left = std::clamp<int64_t>(x, 0, m_width);
+	auto const right = std::clamp<int64_t>(x + width, 0, m_width);
+	auto const top = std::clamp<int64_t>(y, 0, m_height);
+	auto const bottom = std::clamp<int64_t>(y + height, 0, m_height);
+
+	auto const stride = m_width + 1;
+	auto const inside = m_sums[bottom * stride + right] - m_sums[top * stride + right] -
+		m_sums[bottom * stride + left] + m_sums[top * stride + left];
+	auto const outside = width * height - (right - left) * (bottom - top);
+
+	return inside + m_background * double(outside);
+}
+
+CorrelationPeak IntegralImage::peak(
+	KernelRectangle const& rectangle, size_t kernelWidth, size_t kernelHeight, double tolerance,
+	ClippedEdges clipped
+) const {
+	CorrelationPeak peak;
+
+	auto const left = clipped.left ? kernelWidth - 1 : 0;
+	auto const top = clipped.top ? kernelHeight - 1 : 0;
+	auto const right = clipped.right ? m_width : m_width + kernelWidth - 1;
+	auto const bottom = clipped.bottom ? m_height : m_height + kernelHeight - 1;
+	for (size_t y = top; y < bottom; ++y) {
+		auto const placementY = int64_t(y) - int64_t(kernelHeight) + 1;
+		for (size_t x = left; x < right; ++x) {
+			auto const placementX = int64_t(x) - int64_t(kernelWidth) + 1;
+			auto score = rectangle.weight * this->sum(
+				placementX + rectangle.x, placementY + rectangle.y, rectangle.width, rectangle.height
+			);
+
+			if (score > peak.score + tolerance) {
+				peak.score = score;
+				peak.x = int32_t(placementX);
+				peak.y = int32_t(placementY);
+			}
+		}
+	}
+
+	return peak;
+}
+
+void IntegralImage::correlate(
+	KernelRectangle const& rectangle, size_t kernelWidth, size_t kernelHeight, Matrix<double>& map,
+	size_t left, size_t top, size_t right, size_t bottom
+) const {
+	for (size_t y = top; y < bottom; ++y) {
+		auto const placementY = int64_t(y) - int64_t(kernelHeight) + 1;
+		for (size_t x = left; x < right; ++x) {
+			auto const placementX = int64_t(x) - int64_t(kernelWidth) + 1;
+			map(x, y) = rectangle.weight * this->sum(
+				placementX + rectangle.x, placementY + rectangle.y, rectangle.width, rectangle.height
+			);
+		}
+	}
+}
@@ -0,0 +1,440 @@
+#include <KernelBank.hpp>
+#include <ghc/filesystem.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <numbers>
+#include <oneapi/tbb/parallel_for.h>
+
+using namespace tulip::text;
+
+namespace tbb = oneapi::tbb;
+
+namespace {
+	constexpr uint64_t s_fnvOffset = 0xcbf29ce484222325;
+	constexpr uint64_t s_fnvPrime = 0x100000001b3;
+	// bump when the file layout changes
+	constexpr uint32_t s_fileVersion = 1;
+	constexpr char s_fileMagic[4] = { 'T', 'O', 'K', 'B' };
+
+	void hashBytes(uint64_t& hash, void const* data, size_t size) {
+		auto bytes = static_cast<unsigned char const*>(data);
+		for (size_t i = 0; i < size; ++i) {
+			hash = (hash ^ bytes[i]) * s_fnvPrime;
+		}
+	}
+
+	// raw native layout, fixed sizes so records can be read in place
+	struct FileHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t fingerprint;
+		uint64_t count;
+		uint64_t maskBytes;
+		// fnv-1a of the records and masks
+		uint64_t checksum;
+	};
+
+	struct FileRecord {
+		int32_t objectId;
+		int32_t width;
+		int32_t height;
+		int32_t padding;
+		double scale;
+		double rotation;
+		double centerX;
+		double centerY;
+		uint64_t offset;
+		uint64_t count;
+	};
+
+	struct Resampled {
+		std::vector<uint8_t> mask;
+		int32_t width = 0;
+		int32_t height = 0;
+		double centerX = 0;
+		double centerY = 0;
+		size_t count = 0;
+	};
+
+	// inclusive range, robust against the step not dividing it exactly
+	std::vector<double> sweepValues(double minimum, double maximum, double step) {
+		if (step <= 0 || maximum <= minimum) {
+			return { minimum };
+		}
+		auto count = size_t(std::floor((maximum - minimum) / step + 1e-9)) + 1;
+		std::vector<double> ret;
+		for (size_t i = 0; i < count; ++i) {
+			ret.push_back(minimum + double(i) * step);
+		}
+		return ret;
+	}
+
+	// nearest sprite pixel under every mask pixel centre, the mask covering the rotated sprite
+	Resampled resample(
+		uint8_t const* rgba, size_t sourceWidth, size_t sourceHeight, double scale, double rotation,
+		double threshold
+	) {
+		Resampled ret;
+
+		auto const pixelScale = 2.0 * scale;
+		auto const angle = rotation * std::numbers::pi / 180.0;
+		auto const cos = std::cos(angle);
+		auto const sin = std::sin(angle);
+		auto const scaledWidth = double(sourceWidth) * pixelScale;
+		auto const scaledHeight = double(sourceHeight) * pixelScale;
+
+		// a little slack so exact multiples of 90 degrees do not grow a pixel
+		auto const width = int32_t(std::ceil(std::abs(scaledWidth * cos) + std::abs(scaledHeight * sin) - 1e-6));
+		auto const height = int32_t(std::ceil(std::abs(scaledWidth * sin) + std::abs(scaledHeight * cos) - 1e-6));
+		if (width <= 0 || height <= 0) {
+			return ret;
+		}
+
+		auto const centerX = width / 2.0;
+		auto const centerY = height / 2.0;
+
+		std::vector<uint8_t> full(size_t(width) * height, 0);
+		int32_t left = width, top = height, right = -1, bottom = -1;
+		for (int32_t y = 0; y < height; ++y) {
+			for (int32_t x = 0; x < width; ++x) {
+				auto const dx = x + 0.5 - centerX;
+				auto const dy = y + 0.5 - centerY;
+				auto const u = std::floor((cos * dx + sin * dy) / pixelScale + sourceWidth / 2.0);
+				auto const v = std::floor((-sin * dx + cos * dy) / pixelScale + sourceHeight / 2.0);
+				if (u < 0 || v < 0 || u >= double(sourceWidth) || v >= double(sourceHeight)) {
+					continue;
+				}
+
+				auto const texel = rgba + (size_t(v) * sourceWidth + size_t(u)) * 4;
+				auto const value = (0.299 * texel[0] + 0.587 * texel[1] + 0.114 * texel[2]) / 255.0 * texel[3] / 255.0;
+				if (value < threshold) {
+					continue;
+				}
+
+				full[size_t(y) * width + x] = 1;
+				left = std::min(left, x);
+				top = std::min(top, y);
+				right = std::max(right, x);
+				bottom = std::max(bottom, y);
+			}
+		}
+
+		if (right < 0) {
+			return ret;
+		}
+
+		// the empty border says nothing about the kernel and would hide duplicates
+		ret.width = right - left + 1;
+		ret.height = bottom - top + 1;
+		ret.centerX = centerX - left;
+		ret.centerY = centerY - top;
+		ret.mask.resize(size_t(ret.width) * ret.height);
+		for (int32_t y = 0; y < ret.height; ++y) {
+			std::memcpy(
+				ret.mask.data() + size_t(y) * ret.width, full.data() + size_t(y + top) * width + left, ret.width
+			);
+		}
+		ret.count = std::count(ret.mask.begin(), ret.mask.end(), 1);
+		return ret;
+	}
+}
+
+void KernelBank::setSource(int32_t objectId, uint8_t const* rgba, size_t width, size_t height) {
+	m_sources[objectId] = Source{ width, height, std::vector<uint8_t>(rgba, rgba + width * height * 4) };
+}
+
+void KernelBank::setThreshold(double threshold) {
+	m_threshold = threshold;
+}
+
+void KernelBank::setTolerance(double tolerance) {
+	m_tolerance = tolerance;
+}
+
+size_t KernelBank::maskBytes() const {
+	if (m_kernels.empty()) {
+		return 0;
+	}
+	auto const& last = m_kernels.back();
+	return last.offset + size_t(last.width) * last.height;
+}
+
+bool KernelBank::isDuplicate(
+	std::vector<uint8_t> const& mask, int32_t width, int32_t height, size_t count
+) const {
+	auto const allowed = size_t(m_tolerance * double(mask.size()));
+
+	if (allowed == 0) {
+		auto it = m_sizes.find({ width, height });
+		if (it == m_sizes.end()) {
+			return false;
+		}
+		for (auto index : it->second) {
+			if (m_kernels[index].count == count && std::memcmp(this->mask(index), mask.data(), mask.size()) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// differing pixels with other placed at (dx, dy) in the box covering both, stopping past allowed
+	auto const difference = [&](BankKernel const& kernel, uint8_t const* other, int32_t dx, int32_t dy) {
+		auto const boxWidth = std::max(width, kernel.width);
+		auto const boxHeight = std::max(height, kernel.height);
+		auto const ownX = width < boxWidth ? boxWidth - width - dx : 0;
+		auto const ownY = height < boxHeight ? boxHeight - height - dy : 0;
+		auto const otherX = kernel.width < boxWidth ? dx : 0;
+		auto const otherY = kernel.height < boxHeight ? dy : 0;
+
+		auto const at = [](uint8_t const* values, int32_t valuesWidth, int32_t valuesHeight, int32_t x, int32_t y) {
+			return x >= 0 && y >= 0 && x < valuesWidth && y < valuesHeight ? values[size_t(y) * valuesWidth + x] : 0;
+		};
+
+		size_t different = 0;
+		for (int32_t y = 0; y < boxHeight && different <= allowed; ++y) {
+			for (int32_t x = 0; x < boxWidth; ++x) {
+				different += at(mask.data(), width, height, x - ownX, y - ownY) !=
+					at(other, kernel.width, kernel.height, x - otherX, y - otherY);
+			}
+		}
+		return different;
+	};
+
+	// a slightly different rotation or scale can grow the cropped mask by a pixel
+	for (int32_t candidateHeight = height - 1; candidateHeight <= height + 1; ++candidateHeight) {
+		for (int32_t candidateWidth = width - 1; candidateWidth <= width + 1; ++candidateWidth) {
+			auto it = m_sizes.find({ candidateWidth, candidateHeight });
+			if (it == m_sizes.end()) {
+				continue;
+			}
+
+			for (auto index : it->second) {
+				auto const& kernel = m_kernels[index];
+				if ((kernel.count > count ? kernel.count - count : count - kernel.count) > allowed) {
+					continue;
+				}
+
+				auto const other = this->mask(index);
+				auto const shiftsX = std::abs(candidateWidth - width);
+				auto const shiftsY = std::abs(candidateHeight - height);
+				for (int32_t dy = 0; dy <= shiftsY; ++dy) {
+					for (int32_t dx = 0; dx <= shiftsX; ++dx) {
+						if (difference(kernel, other, dx, dy) <= allowed) {
+							return true;
+						}
+					}
+				}
+			}
+		}
+	}
+	return false;
+}
+
+size_t KernelBank::build(std::vector<KernelSweep> const& sweeps) {
+	struct Job {
+		int32_t objectId;
+		Source const* source;
+		double scale;
+		double rotation;
+	};
+
+	std::vector<Job> jobs;
+	for (auto const& sweep : sweeps) {
+		auto it = m_sources.find(sweep.objectId);
+		if (it == m_sources.end()) {
+			continue;
+		}
+		for (auto scale : sweepValues(sweep.minScale, sweep.maxScale, sweep.scaleStep)) {
+			for (auto rotation : sweepValues(sweep.minRotation, sweep.maxRotation, sweep.rotationStep)) {
+				jobs.push_back({ sweep.objectId, &it->second, scale, rotation });
+			}
+		}
+	}
+
+	// appending needs the masks in memory
+	if (m_mapping) {
+		m_arena.assign(m_mappedMasks, m_mappedMasks + this->maskBytes());
+		m_mapping.reset();
+		m_mappedMasks = nullptr;
+	}
+
+	std::vector<Resampled> resampled(jobs.size());
+	tbb::parallel_for(size_t(0), jobs.size(), [&](size_t index) {
+		auto const& job = jobs[index];
+		resampled[index] = resample(
+			job.source->rgba.data(), job.source->width, job.source->height, job.scale, job.rotation, m_threshold
+		);
+	});
+
+	// deduplicated in sweep order so the bank does not depend on scheduling
+	size_t added = 0;
+	for (size_t index = 0; index < jobs.size(); ++index) {
+		auto& result = resampled[index];
+		if (result.count == 0 || this->isDuplicate(result.mask, result.width, result.height, result.count)) {
+			continue;
+		}
+
+		auto const& job = jobs[index];
+		m_sizes[{ result.width, result.height }].push_back(m_kernels.size());
+		m_kernels.push_back({
+			job.objectId, job.scale, job.rotation, m_arena.size(), result.width, result.height,
+			result.centerX, result.centerY, result.count
+		});
+		m_arena.insert(m_arena.end(), result.mask.begin(), result.mask.end());
+		++added;
+	}
+
+	return added;
+}
+
+ObjectKernel KernelBank::objectKernel(size_t index, double weight) const {
+	auto const& kernel = m_kernels[index];
+	auto const mask = this->mask(index);
+
+	std::vector<double> data(size_t(kernel.width) * kernel.height);
+	for (size_t i = 0; i < data.size(); ++i) {
+		data[i] = mask[i] ? weight : 0.0;
+	}
+
+	// create places an object at offset + score / 2 with y pointing up
+	return ObjectKernel{
+		std::move(data), kernel.width, kernel.height, kernel.centerX / 2.0, -kernel.centerY / 2.0,
+		kernel.objectId, kernel.scale * 2.0, kernel.rotation
+	};
+}
+
+uint64_t KernelBank::fingerprint(std::vector<KernelSweep> const& sweeps) const {
+	auto hash = s_fnvOffset;
+	auto add = [&](auto value) {
+		hashBytes(hash, &value, sizeof(value));
+	};
+
+	add(s_fileVersion);
+	for (auto const& [objectId, source] : m_sources) {
+		add(objectId);
+		add(uint64_t(source.width));
+		add(uint64_t(source.height));
+		hashBytes(hash, source.rgba.data(), source.rgba.size());
+	}
+	add(m_threshold);
+	add(m_tolerance);
+	for (auto const& sweep : sweeps) {
+		add(sweep.objectId);
+		add(sweep.minScale);
+		add(sweep.maxScale);
+		add(sweep.scaleStep);
+		add(sweep.minRotation);
+		add(sweep.maxRotation);
+		add(sweep.rotationStep);
+	}
+	return hash;
+}
+
+bool KernelBank::save(ghc::filesystem::path const& path, uint64_t fingerprint) const {
+	std::vector<FileRecord> records;
+	for (auto const& kernel : m_kernels) {
+		records.push_back({
+			kernel.objectId, kernel.width, kernel.height, 0, kernel.scale, kernel.rotation, kernel.centerX,
+			kernel.centerY, uint64_t(kernel.offset), uint64_t(kernel.count)
+		});
+	}
+
+	auto const maskBytes = this->maskBytes();
+
+	FileHeader header = {};
+	std::memcpy(header.magic, s_fileMagic, sizeof(s_fileMagic));
+	header.version = s_fileVersion;
+	header.fingerprint = fingerprint;
+	header.count = records.size();
+	header.maskBytes = maskBytes;
+	header.checksum = s_fnvOffset;
+	hashBytes(header.checksum, records.data(), records.size() * sizeof(FileRecord));
+	hashBytes(header.checksum, this->masks(), maskBytes);
+
+	std::error_code error;
+	if (path.has_parent_path()) {
+		ghc::filesystem::create_directories(path.parent_path(), error);
+	}
+
+	// written next to the target and renamed, so a mapped reader never sees half a file
+	auto temporary = path;
+	temporary += ".tmp";
+	{
+		std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+		if (!stream) {
+			return false;
+		}
+		stream.write(reinterpret_cast<char const*>(&header), sizeof(header));
+		stream.write(reinterpret_cast<char const*>(records.data()), records.size() * sizeof(FileRecord));
+		stream.write(reinterpret_cast<char const*>(this->masks()), maskBytes);
+		if (!stream) {
+			return false;
+		}
+	}
+	ghc::filesystem::rename(temporary, path, error);
+	return !error;
+}
+
+bool KernelBank::load(ghc::filesystem::path const& path, uint64_t fingerprint) {
+	auto mapping = std::make_shared<MappedFile>(path);
+	if (!mapping->valid() || mapping->size() < sizeof(FileHeader)) {
+		return false;
+	}
+
+	FileHeader header;
+	std::memcpy(&header, mapping->data(), sizeof(header));
+	if (std::memcmp(header.magic, s_fileMagic, sizeof(s_fileMagic)) != 0 || header.version != s_fileVersion ||
+		header.fingerprint != fingerprint) {
+		return false;
+	}
+
+	auto const recordBytes = header.count * sizeof(FileRecord);
+	if (header.count > mapping->size() / sizeof(FileRecord) ||
+		mapping->size() != sizeof(FileHeader) + recordBytes + header.maskBytes) {
+		return false;
+	}
+
+	auto const records = mapping->data() + sizeof(FileHeader);
+	auto const masks = records + recordBytes;
+
+	auto checksum = s_fnvOffset;
+	hashBytes(checksum, records, recordBytes + header.maskBytes);
+	if (checksum != header.checksum) {
+		return false;
+	}
+
+	std::vector<BankKernel> kernels;
+	std::map<std::pair<int32_t, int32_t>, std::vector<size_t>> sizes;
+	for (size_t index = 0; index < header.count; ++index) {
+		FileRecord record;
+		std::memcpy(&record, records + index * sizeof(FileRecord), sizeof(record));
+		if (record.width <= 0 || record.height <= 0 ||
+			record.offset + uint64_t(record.width) * uint64_t(record.height) > header.maskBytes) {
+			return false;
+		}
+
+		sizes[{ record.width, record.height }].push_back(kernels.size());
+		kernels.push_back({
+			record.objectId, record.scale, record.rotation, size_t(record.offset), record.width, record.height,
+			record.centerX, record.centerY, size_t(record.count)
+		});
+	}
+
+	m_kernels = std::move(kernels);
+	m_sizes = std::move(sizes);
+	m_arena.clear();
+	m_mapping = std::move(mapping);
+	m_mappedMasks = masks;
+	return true;
+}
+
+void KernelBank::clear() {
+	m_mapping.reset();
+	m_mappedMasks = nullptr;
+	m_arena.clear();
+	m_kernels.clear();
+	m_sizes.clear();
+}
@@ -1,5 +1,6 @@
 #include <Geode/Geode.hpp>
 #include <Generator.hpp>
+#include <KernelBank.hpp>
 
 using namespace geode::prelude;
 using namespace tulip::text;
@@ -21,31 +22,28 @@ struct DispatcherHook : Modify<DispatcherHook, CCIMEDispatcher> {
     }
 };
 
-ObjectKernel kernelFromObject(int id, double scale, double rotation, double multiplier) {
+// the object's sprite frame, drawn once at its original size, as the bank's source for it
+// the bank resamples every scale and rotation from it on the cpu
+bool addObjectSource(KernelBank& bank, int id) {
     // get the texture name 
     auto spriteName = ObjectToolbox::sharedState()->intKeyToFrame(id);
 
     log::debug("Sprite name: {}", spriteName);
 
-    // first get the sprite texture
     auto spriteFrame = CCSpriteFrameCache::sharedSpriteFrameCache()->spriteFrameByName(spriteName);
-    auto frameSize = spriteFrame->getOriginalSizeInPixels();
-
-    int width = frameSize.width * 2 * scale;
-    int height = frameSize.height * 2 * scale;
-
-    log::debug("Frame size: {}, {}", frameSize.width, frameSize.height);
-    log::debug("Width: {}, Height: {}", width, height);
+    if (!spriteFrame) {
+        log::error("No sprite frame for object {}", id);
+        return false;
+    }
+    auto frameSize = spriteFrame->getOriginalSize();
 
     // create a render texture
-    auto renderTexture = CCRenderTexture::create(width, height, kCCTexture2DPixelFormat_RGBA8888);
+    auto renderTexture = CCRenderTexture::create(frameSize.width, frameSize.height, kCCTexture2DPixelFormat_RGBA8888);
     renderTexture->beginWithClear(0, 0, 0, 0);
 
-    // draw the sprite
+    // draw the sprite, flipped so the image comes back top row first
     auto sprite = CCSprite::createWithSpriteFrame(spriteFrame);
-    sprite->setScale(scale);
-    sprite->setRotation(rotation);
-    sprite->setPosition({width / 8.0, height / 8.0});
+    sprite->setPosition({frameSize.width / 2, frameSize.height / 2});
     sprite->setFlipY(true);
     sprite->setAnchorPoint({0.5, 0.5});
     sprite->visit();
@@ -55,84 +53,41 @@ ObjectKernel kernelFromObject(int id, double scale, double rotation, double mult
 
     // get the raw image
     auto image = renderTexture->newCCImage(false);
-    auto data = image->getData();
-    auto iWidth = image->getWidth();
-    auto iHeight = image->getHeight();
-    log::debug("Image size: {}, {}", iWidth, iHeight);
-
-    // make image grayscale 
-    std::vector<double> grayscale(width * height);
-    for (int i = 0; i < width; i++) {
-        for (int j = 0; j < height; j++){
-            auto index = (i * iWidth) + j;
-            auto r = data[index * 4 + 0];
-            auto g = data[index * 4 + 1];
-            auto b = data[index * 4 + 2];
-            auto a = data[index * 4 + 3];
-            grayscale[i * width + j] = (0.299 * r + 0.587 * g + 0.114 * b) / 255.0;
-            grayscale[i * width + j] *= a / 255.0;
-            if (grayscale[i * width + j] < 0.7) {
-                grayscale[i * width + j] = 0.0;
-            }
-            else {
-                grayscale[i * width + j] = multiplier;
-            }
-        }
-    }
+    log::debug("Image size: {}, {}", image->getWidth(), image->getHeight());
 
-    delete image;
-
-    // // surround image with a 1px negative border
-    // for (int i = 1; i < width - 1; ++i) {
-    //     for (int j = 1; j < height - 1; ++j) {
-    //         auto index = i * width + j;
-
-    //         if (grayscale[index] >= 0.7) {
-    //             if (grayscale[index - 1] < 0.7)
-    //                 grayscale[index - 1] = -0.5;
-    //             if (grayscale[index + 1] < 0.7)
-    //                 grayscale[index + 1] = -0.5;
-    //             if (grayscale[index - width] < 0.7)
-    //                 grayscale[index - width] = -0.5;
-    //             if (grayscale[index + width] < 0.7)
-    //                 grayscale[index + width] = -0.5;
-    //         }
-    //     }
-    // }
+    bank.setSource(id, image->getData(), image->getWidth(), image->getHeight());
 
-    // create the kernel
-    ObjectKernel kernel = {
-        std::move(grayscale),
-        width,
-        height,
-        width / 8.0,
-        height / 8.0,
-        id,
-        scale * 2.0,
-        rotation
-    };
-
-    return kernel;
+    delete image;
+    return true;
 }
 
 void testGenerator() {
 
-    std::vector<ObjectKernel> kernels;
-
-    // kernels.push_back(kernelFromObject(211, 0.04, 0.0));
-    
-    for (int i = 0; i < 1; ++i) {
-        for (int j = 11; j <= 11; ++j) {
-            double multiplier = 1.0;
-            if (i == 0) multiplier = 1.1;
-            kernels.push_back(kernelFromObject(211, j * 0.00833333333, i * 7.5, multiplier));
-        }
+    KernelBank bank;
+    if (!addObjectSource(bank, 211)) {
+        return;
     }
 
+    std::vector<KernelSweep> sweeps;
+    sweeps.push_back({ 211, 11 * 0.00833333333, 11 * 0.00833333333, 0, 0, 0, 0 });
     // for (int i = 3; i <= 15; ++i) {
-    //     kernels.push_back(kernelFromObject(1764, 0.05*i, 0.0));
+    //     sweeps.push_back({ 1764, 0.05 * i, 0.05 * i, 0, 0, 0, 0 });
     // }
 
+    // rebuilt only when the sprites or sweeps change, otherwise the masks come mapped from the save
+    auto bankPath = Mod::get()->getSaveDir() / "kernels.bank";
+    auto fingerprint = bank.fingerprint(sweeps);
+    if (!bank.load(bankPath, fingerprint)) {
+        bank.build(sweeps);
+        bank.save(bankPath, fingerprint);
+    }
+    log::debug("{} kernels", bank.size());
+
+    std::vector<ObjectKernel> kernels;
+    for (size_t i = 0; i < bank.size(); ++i) {
+        kernels.push_back(bank.objectKernel(i, 1.1));
+    }
+
     for (int i = 0; i < kernels.size(); ++i) {
         for (int x = 0; x < kernels[i].width; ++x) {
             for (int y = 0; y < kernels[i].height; ++y) {
@@ -143,30 +98,49 @@ void testGenerator() {
         }
     }
 
-    GeneratorConfig config = {
-        std::mutex(),
-        0.0,
-        0.0,
-        0.5,
-        0.5,
-        std::move(kernels),
-        "/Users/student/Desktop/NotoSansJP-Regular.ttf",
-        144.0,
-        50,
-        10.0,
-        -5.0
-    };
+    auto config = std::make_shared<GeneratorConfig>();
+    config->positionX = 0.0;
+    config->positionY = 0.0;
+    config->anchorX = 0.5;
+    config->anchorY = 0.5;
+    config->kernels = std::move(kernels);
+    config->fontPath = "/Users/student/Desktop/NotoSansJP-Regular.ttf";
+    config->fontSize = 144.0;
+    config->objectsPerGlyph = 50;
+    config->minScore = 10.0;
+    config->negativeScore = -5.0;
+    // sfml needs the gl context of the main thread
+    config->rasterBackend = RasterBackend::FreeType;
+
+    // set once createAsync returns, before any queued object runs on the main thread
+    auto task = std::make_shared<std::optional<GenerationTask>>();
+
+    // objects show up in the editor while the rest are still being placed
+    GenerationCallbacks callbacks;
+    callbacks.object = [task](CreatedObject const& object) {
+        queueInMainThread([object, task] {
+            // the editor was left, nothing more is placed into it
+            auto layer = LevelEditorLayer::get();
+            if (!layer) {
+                if (*task) {
+                    (*task)->cancel();
+                }
+                return;
+            }
 
-    auto objects = Generator::get()->create(U"コ", config);
+            log::info("Object: x: {}, y: {}, id: {}, scale: {}, rotation: {}", object.x, object.y, object.objectId, object.scale, object.rotation);
+            auto obj = layer->createObject(object.objectId, {object.x, object.y}, false);
+            obj->setRotation(-object.rotation);
+            obj->m_scale = object.scale;
+            obj->setRScale(1.0f);
 
-    for (auto const& object : objects) {
-        log::info("Object: x: {}, y: {}, id: {}, scale: {}, rotation: {}", object.x, object.y, object.objectId, object.scale, object.rotation);
-        auto obj = LevelEditorLayer::get()->createObject(object.objectId, {object.x, object.y}, false);
-        obj->setRotation(-object.rotation);
-        obj->m_scale = object.scale;
-        obj->setRScale(1.0f);
+            obj->m_isObjectRectDirty = true;
+            obj->m_textureRectDirty = true;
+        });
+    };
+    callbacks.progress = [](GenerationProgress const& progress) {
+        log::debug("Generated {}/{}, {} objects", progress.finished, progress.total, progress.objects);
+    };
 
-        obj->m_isObjectRectDirty = true;
-        obj->m_textureRectDirty = true;
-    }
+    *task = Generator::get()->createAsync(U"コ", std::move(config), std::move(callbacks));
 }
\ No newline at end of file
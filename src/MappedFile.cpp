@@ -0,0 +1,86 @@
+#include <MappedFile.hpp>
+#include <ghc/filesystem.hpp>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace tulip::text;
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(ghc::filesystem::path const& path) {
+	auto file = CreateFileW(
+		path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+	);
+	if (file == INVALID_HANDLE_VALUE) {
+		return;
+	}
+	m_file = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		return;
+	}
+
+	m_mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_mapping) {
+		return;
+	}
+
+	auto view = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view) {
+		return;
+	}
+	m_data = static_cast<uint8_t const*>(view);
+	m_size = size_t(size.QuadPart);
+}
+
+MappedFile::~MappedFile() {
+	if (m_data) {
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mapping) {
+		CloseHandle(m_mapping);
+	}
+	if (m_file) {
+		CloseHandle(m_file);
+	}
+}
+
+#else
+
+MappedFile::MappedFile(ghc::filesystem::path const& path) {
+	m_file = open(path.c_str(), O_RDONLY);
+	if (m_file < 0) {
+		return;
+	}
+
+	struct stat info;
+	if (fstat(m_file, &info) != 0 || info.st_size <= 0) {
+		return;
+	}
+
+	auto view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, m_file, 0);
+	if (view == MAP_FAILED) {
+		return;
+	}
+	m_data = static_cast<uint8_t const*>(view);
+	m_size = size_t(info.st_size);
+}
+
+MappedFile::~MappedFile() {
+	if (m_data) {
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+	}
+	if (m_file >= 0) {
+		close(m_file);
+	}
+}
+
+#endif
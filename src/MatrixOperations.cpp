@@ -1,87 +1,523 @@
 #include <MatrixOperations.hpp>
 #include <fftw3.h>
 #include <algorithm>
+#include <cstring>
+#include <mutex>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#define TEXT_OBJECT_X64 1
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TEXT_OBJECT_TARGET_AVX2
+#else
+#define TEXT_OBJECT_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
 
 using namespace tulip::text;
 
-template <>
-Matrix<double>::Matrix(size_t width, size_t height) : width(width), height(height) {
-    data = fftw_alloc_real(width * height);
+namespace {
+    template <class Complex>
+    using MultiplyFunction = void (*)(Complex const*, Complex const*, Complex*, size_t);
+
+    template <class Complex>
+    void multiplyScalar(Complex const* a, Complex const* b, Complex* out, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            auto const aReal = a[i][0];
+            auto const aImag = a[i][1];
+            auto const bReal = b[i][0];
+            auto const bImag = b[i][1];
+
+            out[i][0] = aReal * bReal - aImag * bImag;
+            out[i][1] = aReal * bImag + aImag * bReal;
+        }
+    }
+
+#if defined(TEXT_OBJECT_X64)
+    void multiplySse2(fftw_complex const* a, fftw_complex const* b, fftw_complex* out, size_t count) {
+        auto const negateReal = _mm_set_pd(0.0, -0.0);
+
+        for (size_t i = 0; i < count; ++i) {
+            auto const va = _mm_loadu_pd(a[i]);
+            auto const vb = _mm_loadu_pd(b[i]);
+
+            // (ar * br, ai * br) + (-ai * bi, ar * bi)
+            auto const real = _mm_mul_pd(va, _mm_unpacklo_pd(vb, vb));
+            auto const cross = _mm_mul_pd(_mm_shuffle_pd(va, va, 1), _mm_unpackhi_pd(vb, vb));
+            _mm_storeu_pd(out[i], _mm_add_pd(real, _mm_xor_pd(cross, negateReal)));
+        }
+    }
+
+    void multiplySse2(fftwf_complex const* a, fftwf_complex const* b, fftwf_complex* out, size_t count) {
+        auto const negateReal = _mm_set_ps(0.0f, -0.0f, 0.0f, -0.0f);
+
+        size_t i = 0;
+        for (; i + 2 <= count; i += 2) {
+            auto const va = _mm_loadu_ps(a[i]);
+            auto const vb = _mm_loadu_ps(b[i]);
+
+            // same as the double version, two complex values per register
+            auto const real = _mm_mul_ps(va, _mm_shuffle_ps(vb, vb, _MM_SHUFFLE(2, 2, 0, 0)));
+            auto const cross = _mm_mul_ps(
+                _mm_shuffle_ps(va, va, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(vb, vb, _MM_SHUFFLE(3, 3, 1, 1))
+            );
+            _mm_storeu_ps(out[i], _mm_add_ps(real, _mm_xor_ps(cross, negateReal)));
+        }
+        multiplyScalar(a + i, b + i, out + i, count - i);
+    }
+
+    TEXT_OBJECT_TARGET_AVX2
+    void multiplyAvx2(fftw_complex const* a, fftw_complex const* b, fftw_complex* out, size_t count) {
+        size_t i = 0;
+        for (; i + 2 <= count; i += 2) {
+            auto const va = _mm256_loadu_pd(a[i]);
+            auto const vb = _mm256_loadu_pd(b[i]);
+
+            // even lanes ar * br - ai * bi, odd lanes ai * br + ar * bi
+            auto const cross = _mm256_mul_pd(_mm256_permute_pd(va, 0x5), _mm256_permute_pd(vb, 0xF));
+            _mm256_storeu_pd(out[i], _mm256_fmaddsub_pd(va, _mm256_movedup_pd(vb), cross));
+        }
+        multiplyScalar(a + i, b + i, out + i, count - i);
+    }
+
+    TEXT_OBJECT_TARGET_AVX2
+    void multiplyAvx2(fftwf_complex const* a, fftwf_complex const* b, fftwf_complex* out, size_t count) {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            auto const va = _mm256_loadu_ps(a[i]);
+            auto const vb = _mm256_loadu_ps(b[i]);
+
+            auto const cross = _mm256_mul_ps(_mm256_permute_ps(va, 0xB1), _mm256_movehdup_ps(vb));
+            _mm256_storeu_ps(out[i], _mm256_fmaddsub_ps(va, _mm256_moveldup_ps(vb), cross));
+        }
+        multiplyScalar(a + i, b + i, out + i, count - i);
+    }
+
+    bool supportsAvx2() {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        bool const fma = info[2] & (1 << 12);
+        bool const osxsave = info[2] & (1 << 27);
+        if (!fma || !osxsave || (_xgetbv(0) & 0x6) != 0x6) {
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        return info[1] & (1 << 5);
+#else
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    }
+#endif
+
+    template <class Complex>
+    MultiplyFunction<Complex> selectMultiply() {
+#if defined(TEXT_OBJECT_X64)
+        if (supportsAvx2()) {
+            return &multiplyAvx2;
+        }
+        return &multiplySse2;
+#else
+        return &multiplyScalar<Complex>;
+#endif
+    }
+
+    // the fftw entry points of each precision
+    template <class Real>
+    struct Backend;
+
+    template <>
+    struct Backend<double> {
+        static constexpr auto allocReal = &fftw_alloc_real;
+        static constexpr auto allocComplex = &fftw_alloc_complex;
+        static constexpr auto free = &fftw_free;
+        static constexpr auto planForward = &fftw_plan_many_dft_r2c;
+        static constexpr auto planBackward = &fftw_plan_many_dft_c2r;
+        static constexpr auto executeForward = &fftw_execute_dft_r2c;
+        static constexpr auto executeBackward = &fftw_execute_dft_c2r;
+        static constexpr auto destroy = &fftw_destroy_plan;
+        static constexpr auto alignmentOf = &fftw_alignment_of;
+        static constexpr auto importWisdom = &fftw_import_wisdom_from_filename;
+        static constexpr auto exportWisdom = &fftw_export_wisdom_to_filename;
+    };
+
+    template <>
+    struct Backend<float> {
+        static constexpr auto allocReal = &fftwf_alloc_real;
+        static constexpr auto allocComplex = &fftwf_alloc_complex;
+        static constexpr auto free = &fftwf_free;
+        static constexpr auto planForward = &fftwf_plan_many_dft_r2c;
+        static constexpr auto planBackward = &fftwf_plan_many_dft_c2r;
+        static constexpr auto executeForward = &fftwf_execute_dft_r2c;
+        static constexpr auto executeBackward = &fftwf_execute_dft_c2r;
+        static constexpr auto destroy = &fftwf_destroy_plan;
+        static constexpr auto alignmentOf = &fftwf_alignment_of;
+        static constexpr auto importWisdom = &fftwf_import_wisdom_from_filename;
+        static constexpr auto exportWisdom = &fftwf_export_wisdom_to_filename;
+    };
+}
+
+void tulip::text::multiplySpectra(
+    fftw_complex const* a, fftw_complex const* b, fftw_complex* out, size_t count
+) {
+    static auto const s_multiply = selectMultiply<fftw_complex>();
+    s_multiply(a, b, out, count);
+}
+
+void tulip::text::multiplySpectra(
+    fftwf_complex const* a, fftwf_complex const* b, fftwf_complex* out, size_t count
+) {
+    static auto const s_multiply = selectMultiply<fftwf_complex>();
+    s_multiply(a, b, out, count);
 }
 
-template <>
-Matrix<double>::~Matrix() {
+size_t tulip::text::fftSize(size_t minimum) {
+    for (auto size = std::max<size_t>(minimum, 1);; ++size) {
+        auto rest = size;
+        for (size_t factor : { 2, 3, 5, 7 }) {
+            while (rest % factor == 0) {
+                rest /= factor;
+            }
+        }
+        if (rest == 1) {
+            return size;
+        }
+    }
+}
+
+// fftw_malloc gives the simd alignment fftw plans for, whatever the element type
+template <class Type>
+Matrix<Type>::Matrix(size_t width, size_t height) : width(width), height(height) {
+    data = static_cast<Type*>(fftw_malloc(sizeof(Type) * width * height));
+}
+
+template <class Type>
+Matrix<Type>::~Matrix() {
     fftw_free(data);
 }
 
-template <>
-void Matrix<double>::zero() {
-    std::fill(data, data + width * height, 0);
+template <class Type>
+void Matrix<Type>::zero() {
+    std::memset(data, 0, sizeof(Type) * width * height);
 }
 
-template <>
-void Matrix<double>::fill(double value) {
+template <class Type>
+void Matrix<Type>::fill(Type value) {
     std::fill(data, data + width * height, value);
 }
 
-template <>
-Matrix<fftw_complex>::Matrix(size_t width, size_t height) : width(width), height(height) {
-    data = fftw_alloc_complex(width * height);
+template struct tulip::text::Matrix<double>;
+template struct tulip::text::Matrix<float>;
+
+// complex entries are arrays, so they get no fill
+template Matrix<fftw_complex>::Matrix(size_t, size_t);
+template Matrix<fftw_complex>::~Matrix();
+template void Matrix<fftw_complex>::zero();
+template Matrix<fftwf_complex>::Matrix(size_t, size_t);
+template Matrix<fftwf_complex>::~Matrix();
+template void Matrix<fftwf_complex>::zero();
+
+template <class Real>
+Plan<Real>::Plan(PlanHandle<Real> plan) : plan(plan) {}
+
+template <class Real>
+Plan<Real>::~Plan() {
+    if (plan) {
+        Backend<Real>::destroy(plan);
+    }
 }
 
-template <>
-Matrix<fftw_complex>::~Matrix() {
-    fftw_free(data);
+template <class Real>
+PlanCache<Real>& PlanCache<Real>::get() {
+    static PlanCache s_ret;
+    return s_ret;
+}
+
+template <class Real>
+void PlanCache<Real>::setFlags(unsigned flags) {
+    std::lock_guard lock(m_mutex);
+    m_flags = flags;
+}
+
+template <class Real>
+PlanHandle<Real> PlanCache<Real>::find(Key key) {
+    std::lock_guard lock(m_mutex);
+
+    key.flags = m_flags;
+    auto flags = key.flags | (key.aligned ? 0 : FFTW_UNALIGNED);
+    auto it = m_plans.find(key);
+    if (it != m_plans.end()) {
+        return it->second.plan;
+    }
+
+    // measuring overwrites the buffers, so plan on scratch ones of the same layout
+    auto const realSize = key.width * key.height;
+    auto const complexSize = key.height * (key.width / 2 + 1);
+    auto complex = Backend<Real>::allocComplex(complexSize * key.count);
+    auto real = key.inPlace ? reinterpret_cast<Real*>(complex) : Backend<Real>::allocReal(realSize * key.count);
+    auto const realDistance = key.inPlace ? complexSize * 2 : realSize;
+
+    int const size[] = { int(key.height), int(key.width) };
+    PlanHandle<Real> plan;
+    if (key.forward) {
+        plan = Backend<Real>::planForward(
+            2, size, key.count, real, nullptr, 1, realDistance, complex, nullptr, 1, complexSize, flags
+        );
+    }
+    else {
+        plan = Backend<Real>::planBackward(
+            2, size, key.count, complex, nullptr, 1, complexSize, real, nullptr, 1, realDistance, flags
+        );
+    }
+
+    if (!key.inPlace) {
+        Backend<Real>::free(real);
+    }
+    Backend<Real>::free(complex);
+
+    m_wisdomChanged = m_wisdomChanged || !(key.flags & FFTW_ESTIMATE);
+    return m_plans.try_emplace(key, plan).first->second.plan;
+}
+
+template <class Real>
+PlanHandle<Real> PlanCache<Real>::forward(
+    size_t width, size_t height, size_t count, Real* input, Complex<Real>* output
+) {
+    return this->find({
+        true, width, height, count, static_cast<void*>(input) == static_cast<void*>(output),
+        Backend<Real>::alignmentOf(input) == 0 &&
+            Backend<Real>::alignmentOf(reinterpret_cast<Real*>(output)) == 0
+    });
+}
+
+template <class Real>
+PlanHandle<Real> PlanCache<Real>::backward(
+    size_t width, size_t height, size_t count, Complex<Real>* input, Real* output
+) {
+    return this->find({
+        false, width, height, count, static_cast<void*>(input) == static_cast<void*>(output),
+        Backend<Real>::alignmentOf(reinterpret_cast<Real*>(input)) == 0 &&
+            Backend<Real>::alignmentOf(output) == 0
+    });
+}
+
+template <class Real>
+bool PlanCache<Real>::loadWisdom(std::string const& path) {
+    std::lock_guard lock(m_mutex);
+    m_wisdomChanged = false;
+    return Backend<Real>::importWisdom(path.c_str());
 }
 
-template <>
-void Matrix<fftw_complex>::zero() {
-    std::fill(*data, *data + width * height * 2, 0);
+template <class Real>
+bool PlanCache<Real>::saveWisdom(std::string const& path) {
+    std::lock_guard lock(m_mutex);
+    if (!m_wisdomChanged) {
+        return false;
+    }
+    m_wisdomChanged = false;
+    return Backend<Real>::exportWisdom(path.c_str());
 }
 
-Plan::Plan(fftw_plan plan) : plan(plan) {}
+template <class Real>
+KernelSpectrumBank<Real>::KernelSpectrumBank(size_t width, size_t height) :
+    width(width),
+    height(height),
+    m_staging(width, height),
+    m_result(width / 2 + 1, height),
+    m_plan(PlanCache<Real>::get().forward(width, height, 1, m_staging.data, m_result.data)) {}
+
+template <class Real>
+size_t KernelSpectrumBank<Real>::add(double const* kernel, size_t kernelWidth, size_t kernelHeight) {
+    m_staging.zero();
+    for (size_t y = 0; y < kernelHeight; ++y) {
+        for (size_t x = 0; x < kernelWidth; ++x) {
+            m_staging(kernelWidth - 1 - x, kernelHeight - 1 - y) = Real(kernel[y * kernelWidth + x]);
+        }
+    }
+
+    Backend<Real>::executeForward(m_plan, m_staging.data, m_result.data);
+
+    // fold the inverse transform's 1 / n into the kernel
+    auto const scale = Real(1) / Real(width * height);
+    auto& spectrum = spectra.emplace_back(m_result.width, m_result.height);
+    auto const values = m_result.width * m_result.height * 2;
+    std::transform(*m_result.data, *m_result.data + values, *spectrum.data, [&](Real value) {
+        return value * scale;
+    });
+    extents.emplace_back(kernelWidth, kernelHeight);
 
-Plan::~Plan() {
-    fftw_destroy_plan(plan);
+    return spectra.size() - 1;
 }
 
-Convolution::Convolution(Matrix<double>& input, Matrix<double>& kernel, Matrix<double>& output) :
+template <class Real>
+Convolution<Real>::Convolution(Matrix<Real>& input, Matrix<Real>& kernel, Matrix<Real>& output) :
     input(input),
     kernel(kernel),
     output(output),
-    inputResult(input.width, input.height),
-    kernelResult(kernel.width, kernel.height),
-    kernelPlan(fftw_plan_dft_r2c_2d(kernel.width, kernel.height, kernel.data, kernelResult.data, FFTW_ESTIMATE)),
-    inputPlan(fftw_plan_dft_r2c_2d(input.width, input.height, input.data, inputResult.data, FFTW_ESTIMATE)),
-    outputPlan(fftw_plan_dft_c2r_2d(output.width, output.height, inputResult.data, output.data, FFTW_ESTIMATE)) {
+    inputResult(input.width / 2 + 1, input.height),
+    kernelResult(kernel.width / 2 + 1, kernel.height),
+    kernelPlan(PlanCache<Real>::get().forward(kernel.width, kernel.height, 1, kernel.data, kernelResult.data)),
+    inputPlan(PlanCache<Real>::get().forward(input.width, input.height, 1, input.data, inputResult.data)),
+    outputPlan(PlanCache<Real>::get().backward(output.width, output.height, 1, inputResult.data, output.data)) {
 
     }
 
-Convolution::~Convolution() {
-    fftw_free(inputResult.data);
-    fftw_free(kernelResult.data);
-    fftw_destroy_plan(kernelPlan.plan);
-    fftw_destroy_plan(inputPlan.plan);
-    fftw_destroy_plan(outputPlan.plan);
+template <class Real>
+Convolution<Real>::~Convolution() {}
+
+template <class Real>
+void Convolution<Real>::execute() {
+    Backend<Real>::executeForward(kernelPlan, kernel.data, kernelResult.data);
+
+    auto const scale = Real(1) / Real(kernel.width * kernel.height);
+    auto const values = kernelResult.width * kernelResult.height * 2;
+    std::transform(*kernelResult.data, *kernelResult.data + values, *kernelResult.data, [&](Real value) {
+        return value * scale;
+    });
+
+    this->execute(kernelResult);
+}
+
+template <class Real>
+void Convolution<Real>::execute(Matrix<Complex<Real>> const& kernelSpectrum) {
+    Backend<Real>::executeForward(inputPlan, input.data, inputResult.data);
+    multiplySpectra(
+        inputResult.data, kernelSpectrum.data, inputResult.data, inputResult.width * inputResult.height
+    );
+    Backend<Real>::executeBackward(outputPlan, inputResult.data, output.data);
 }
 
-void Convolution::execute() {
-    fftw_execute(kernelPlan.plan);
-    fftw_execute(inputPlan.plan);
+template <class Real>
+CorrelationPeak tulip::text::findPeak(
+    Real const* map, size_t stride, size_t width, size_t height, size_t kernelWidth,
+    size_t kernelHeight, double tolerance, ClippedEdges clipped
+) {
+    CorrelationPeak peak;
+
+    // entries below kernel - 1 hang over the near edge, entries past input - 1 over the far one
+    auto const left = clipped.left ? kernelWidth - 1 : 0;
+    auto const top = clipped.top ? kernelHeight - 1 : 0;
+    auto const right = clipped.right ? width - kernelWidth + 1 : width;
+    auto const bottom = clipped.bottom ? height - kernelHeight + 1 : height;
 
-    for (size_t i = 0; i < inputResult.width * inputResult.height; ++i) {
-        auto const inputReal = inputResult.data[i][0];
-        auto const inputImag = inputResult.data[i][1];
-        auto const kernelReal = kernelResult.data[i][0];
-        auto const kernelImag = kernelResult.data[i][1];
+    for (size_t y = top; y < bottom; ++y) {
+        for (size_t x = left; x < right; ++x) {
+            double score = map[y * stride + x];
 
-        inputResult.data[i][0] = inputReal * kernelReal - inputImag * kernelImag;
-        inputResult.data[i][1] = inputReal * kernelImag + inputImag * kernelReal;
+            if (score > peak.score + tolerance) {
+                peak.score = score;
+                peak.x = int32_t(x) - int32_t(kernelWidth) + 1;
+                peak.y = int32_t(y) - int32_t(kernelHeight) + 1;
+            }
+        }
     }
 
-    fftw_execute(outputPlan.plan);
+    return peak;
+}
 
-    for (size_t i = 0; i < inputResult.width * inputResult.height; ++i) {
-        output.data[i] /= inputResult.width * inputResult.height;
+template <class Real>
+BatchedCorrelation<Real>::BatchedCorrelation(
+    Matrix<Real>& input, KernelSpectrumBank<Real> const& bank, size_t batchSize
+) :
+    input(input),
+    bank(bank),
+    batchSize(batchSize),
+    inputResult(input.width / 2 + 1, input.height),
+    products(inputResult.width * inputResult.height, batchSize),
+    outputs(input.width * input.height, batchSize),
+    inputPlan(PlanCache<Real>::get().forward(input.width, input.height, 1, input.data, inputResult.data)) {
+
+    }
+
+template <class Real>
+PlanHandle<Real> BatchedCorrelation<Real>::outputPlan(size_t count) {
+    auto it = m_outputPlans.find(count);
+    if (it != m_outputPlans.end()) {
+        return it->second;
     }
-}
\ No newline at end of file
+
+    auto plan = PlanCache<Real>::get().backward(input.width, input.height, count, products.data, outputs.data);
+    return m_outputPlans.try_emplace(count, plan).first->second;
+}
+
+template <class Real>
+void BatchedCorrelation<Real>::transform() {
+    Backend<Real>::executeForward(inputPlan, input.data, inputResult.data);
+}
+
+template <class Real>
+template <class Callback>
+void BatchedCorrelation<Real>::correlateBatches(
+    Matrix<Complex<Real>> const& inputSpectrum, size_t begin, size_t end, Callback&& callback
+) {
+    auto const spectrumSize = products.width;
+
+    for (size_t batch = begin; batch < end; batch += batchSize) {
+        auto const count = std::min(batchSize, end - batch);
+
+        for (size_t k = 0; k < count; ++k) {
+            auto product = products.data + k * spectrumSize;
+            multiplySpectra(inputSpectrum.data, bank[batch + k].data, product, spectrumSize);
+        }
+
+        Backend<Real>::executeBackward(this->outputPlan(count), products.data, outputs.data);
+
+        for (size_t k = 0; k < count; ++k) {
+            callback(batch + k, outputs.data + k * outputs.width);
+        }
+    }
+}
+
+template <class Real>
+void BatchedCorrelation<Real>::correlate(
+    Matrix<Complex<Real>> const& inputSpectrum, size_t begin, size_t end, size_t inputWidth,
+    size_t inputHeight, double tolerance, CorrelationPeak* peaks, ClippedEdges clipped
+) {
+    this->correlateBatches(inputSpectrum, begin, end, [&](size_t kernel, Real const* output) {
+        auto [kernelWidth, kernelHeight] = bank.extents[kernel];
+        peaks[kernel - begin] = findPeak(
+            output, input.width, inputWidth + kernelWidth - 1, inputHeight + kernelHeight - 1,
+            kernelWidth, kernelHeight, tolerance, clipped
+        );
+    });
+}
+
+template <class Real>
+void BatchedCorrelation<Real>::correlate(
+    Matrix<Complex<Real>> const& inputSpectrum, size_t begin, size_t end, Matrix<double>* maps
+) {
+    this->correlateBatches(inputSpectrum, begin, end, [&](size_t kernel, Real const* output) {
+        auto& map = maps[kernel - begin];
+        for (size_t y = 0; y < map.height; ++y) {
+            auto row = output + y * input.width;
+            std::copy(row, row + map.width, map.data + y * map.width);
+        }
+    });
+}
+
+template <class Real>
+std::vector<CorrelationPeak> BatchedCorrelation<Real>::execute(
+    size_t inputWidth, size_t inputHeight, double tolerance
+) {
+    std::vector<CorrelationPeak> peaks(bank.size());
+    this->transform();
+    this->correlate(inputResult, 0, bank.size(), inputWidth, inputHeight, tolerance, peaks.data());
+    return peaks;
+}
+
+#define TEXT_OBJECT_INSTANTIATE(Real)                                                              \
+    template struct tulip::text::Plan<Real>;                                                       \
+    template class tulip::text::PlanCache<Real>;                                                   \
+    template struct tulip::text::KernelSpectrumBank<Real>;                                         \
+    template struct tulip::text::Convolution<Real>;                                                \
+    template struct tulip::text::BatchedCorrelation<Real>;                                         \
+    template CorrelationPeak tulip::text::findPeak<Real>(                                          \
+        Real const*, size_t, size_t, size_t, size_t, size_t, double, ClippedEdges                  \
+    );
+
+TEXT_OBJECT_INSTANTIATE(double)
+TEXT_OBJECT_INSTANTIATE(float)
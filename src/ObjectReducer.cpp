@@ -0,0 +1,388 @@
+#include <ObjectReducer.hpp>
+#include <algorithm>
+#include <cmath>
+#include <optional>
+
+using namespace tulip::text;
+
+namespace {
+	struct Placement {
+		ConvolutionScore score;
+		// bounds of the set pixels on the padded grid, right and bottom exclusive
+		int32_t left;
+		int32_t top;
+		int32_t right;
+		int32_t bottom;
+		size_t count;
+		bool alive = true;
+	};
+
+	struct Bounds {
+		int32_t left;
+		int32_t top;
+		int32_t right;
+		int32_t bottom;
+	};
+}
+
+// coverage of the padded glyph grid and the placements on it
+class ObjectReducer::Reduction {
+	ObjectReducer const& m_reducer;
+	size_t m_gridWidth;
+	size_t m_gridHeight;
+	// what covering a pixel gains, the glyph's value so background costs as much as in scoring
+	std::vector<double> m_values;
+	std::vector<uint16_t> m_cover;
+	std::vector<Placement> m_placements;
+	double m_error = 0.0;
+	double m_budget = 0.0;
+	double m_minScore;
+
+	// placements by the cells their bounds touch
+	static constexpr int32_t s_cellSize = 32;
+	// errors are sums of pixel values, an exact trade must not fail on rounding
+	static constexpr double s_epsilon = 1e-6;
+	size_t m_cellColumns;
+	size_t m_cellRows;
+	std::vector<std::vector<size_t>> m_cells;
+	std::vector<size_t> m_stamps;
+	size_t m_stamp = 0;
+
+public:
+	Reduction(
+		ObjectReducer const& reducer, double const* values, size_t width, size_t height, double background,
+		double minScore
+	) :
+		m_reducer(reducer),
+		m_gridWidth(width + 2 * reducer.m_padding),
+		m_gridHeight(height + 2 * reducer.m_padding),
+		m_values(m_gridWidth * m_gridHeight, background),
+		m_cover(m_gridWidth * m_gridHeight, 0),
+		m_minScore(minScore),
+		m_cellColumns((m_gridWidth + s_cellSize - 1) / s_cellSize),
+		m_cellRows((m_gridHeight + s_cellSize - 1) / s_cellSize),
+		m_cells(m_cellColumns * m_cellRows) {
+		for (size_t y = 0; y < height; ++y) {
+			for (size_t x = 0; x < width; ++x) {
+				auto index = (y + reducer.m_padding) * m_gridWidth + x + reducer.m_padding;
+				m_values[index] = values[y * width + x];
+			}
+		}
+	}
+
+	void setBudget(double budget) {
+		double glyph = 0.0;
+		for (auto value : m_values) {
+			glyph += std::max(value, 0.0);
+		}
+		m_budget = budget * glyph;
+	}
+
+	Placement makePlacement(ConvolutionScore const& score) const {
+		auto const& footprint = m_reducer.m_footprints[score.kernelId];
+		auto const padding = m_reducer.m_padding;
+		return {
+			score, score.x + footprint.left + padding, score.y + footprint.top + padding,
+			score.x + footprint.right + padding, score.y + footprint.bottom + padding, footprint.pixels.size()
+		};
+	}
+
+	// f(index, weight) for every set pixel on the grid
+	template <class F>
+	void forPixels(ConvolutionScore const& score, F&& f) const {
+		auto const padding = m_reducer.m_padding;
+		for (auto [x, y, weight] : m_reducer.m_footprints[score.kernelId].pixels) {
+			auto gridX = score.x + x + padding;
+			auto gridY = score.y + y + padding;
+			if (gridX < 0 || gridY < 0 || gridX >= int32_t(m_gridWidth) || gridY >= int32_t(m_gridHeight)) {
+				continue;
+			}
+			f(size_t(gridY) * m_gridWidth + gridX, weight);
+		}
+	}
+
+	double score(ConvolutionScore const& score) const {
+		double ret = 0.0;
+		this->forPixels(score, [&](size_t index, double weight) {
+			ret += weight * m_values[index];
+		});
+		return ret;
+	}
+
+	void cover(ConvolutionScore const& score) {
+		this->forPixels(score, [&](size_t index, double) {
+			if (m_cover[index]++ == 0) {
+				m_error -= m_values[index];
+			}
+		});
+	}
+
+	void uncover(ConvolutionScore const& score) {
+		this->forPixels(score, [&](size_t index, double) {
+			if (--m_cover[index] == 0) {
+				m_error += m_values[index];
+			}
+		});
+	}
+
+	// what uncovering it would add to the error
+	double removalCost(ConvolutionScore const& score) const {
+		double ret = 0.0;
+		this->forPixels(score, [&](size_t index, double) {
+			if (m_cover[index] == 1) {
+				ret += m_values[index];
+			}
+		});
+		return ret;
+	}
+
+	template <class F>
+	void forCells(Bounds const& bounds, F&& f) {
+		auto const firstColumn = size_t(std::clamp(bounds.left / s_cellSize, 0, int32_t(m_cellColumns) - 1));
+		auto const lastColumn = size_t(std::clamp((bounds.right - 1) / s_cellSize, 0, int32_t(m_cellColumns) - 1));
+		auto const firstRow = size_t(std::clamp(bounds.top / s_cellSize, 0, int32_t(m_cellRows) - 1));
+		auto const lastRow = size_t(std::clamp((bounds.bottom - 1) / s_cellSize, 0, int32_t(m_cellRows) - 1));
+		for (auto row = firstRow; row <= lastRow; ++row) {
+			for (auto column = firstColumn; column <= lastColumn; ++column) {
+				f(m_cells[row * m_cellColumns + column]);
+			}
+		}
+	}
+
+	void add(Placement placement) {
+		this->cover(placement.score);
+		m_placements.push_back(placement);
+		m_stamps.push_back(0);
+		auto const index = m_placements.size() - 1;
+		this->forCells({ placement.left, placement.top, placement.right, placement.bottom }, [&](auto& cell) {
+			cell.push_back(index);
+		});
+	}
+
+	// live placements whose bounds intersect
+	std::vector<size_t> query(Bounds const& bounds) {
+		++m_stamp;
+		std::vector<size_t> ret;
+		this->forCells(bounds, [&](auto const& cell) {
+			for (auto index : cell) {
+				auto const& placement = m_placements[index];
+				if (!placement.alive || m_stamps[index] == m_stamp) {
+					continue;
+				}
+				m_stamps[index] = m_stamp;
+				if (placement.left < bounds.right && placement.right > bounds.left &&
+					placement.top < bounds.bottom && placement.bottom > bounds.top) {
+					ret.push_back(index);
+				}
+			}
+		});
+		return ret;
+	}
+
+	void resetError() {
+		m_error = 0;
+	}
+
+	struct Merge {
+		Placement placement;
+		std::vector<size_t> removed;
+		double error = 0.0;
+	};
+
+	// places candidate, then takes away the overlapping placements it makes cheapest to lose
+	// while the error stays within budget, and undoes all of it
+	Merge evaluate(ConvolutionScore const& candidate) {
+		Merge ret;
+		ret.placement = this->makePlacement(candidate);
+		auto const before = m_error;
+
+		this->cover(candidate);
+		auto overlapping = this->query({ ret.placement.left, ret.placement.top, ret.placement.right, ret.placement.bottom });
+		std::vector<std::pair<double, size_t>> costs;
+		for (auto index : overlapping) {
+			costs.push_back({ this->removalCost(m_placements[index].score), index });
+		}
+		std::sort(costs.begin(), costs.end());
+
+		for (auto [estimate, index] : costs) {
+			// earlier removals may have left it the only cover of some pixels
+			auto cost = this->removalCost(m_placements[index].score);
+			if (m_error + cost <= m_budget + s_epsilon) {
+				this->uncover(m_placements[index].score);
+				ret.removed.push_back(index);
+			}
+		}
+		ret.error = m_error;
+
+		for (auto index : ret.removed) {
+			this->cover(m_placements[index].score);
+		}
+		this->uncover(candidate);
+		m_error = before;
+		return ret;
+	}
+
+	// the best replacement of index, alone or with one neighbour, by a kernel at least as large
+	// aligned to a side or the centre of their bounds
+	bool merge(size_t index) {
+		auto const& placement = m_placements[index];
+		std::vector<Bounds> targets{ { placement.left, placement.top, placement.right, placement.bottom } };
+		for (auto other : this->query({ placement.left - 1, placement.top - 1, placement.right + 1, placement.bottom + 1 })) {
+			if (other == index) {
+				continue;
+			}
+			auto const& neighbour = m_placements[other];
+			targets.push_back({
+				std::min(placement.left, neighbour.left), std::min(placement.top, neighbour.top),
+				std::max(placement.right, neighbour.right), std::max(placement.bottom, neighbour.bottom)
+			});
+		}
+
+		auto const padding = m_reducer.m_padding;
+		std::optional<Merge> best;
+		for (size_t target = 0; target < targets.size(); ++target) {
+			auto const bounds = targets[target];
+			auto const targetWidth = bounds.right - bounds.left;
+			auto const targetHeight = bounds.bottom - bounds.top;
+
+			for (size_t kernel = 0; kernel < m_reducer.m_footprints.size(); ++kernel) {
+				auto const& footprint = m_reducer.m_footprints[kernel];
+				if (footprint.pixels.size() < placement.count || (target == 0 && kernel == placement.score.kernelId)) {
+					continue;
+				}
+				// far smaller kernels cannot cover the target, far larger ones only spill
+				auto const width = footprint.right - footprint.left;
+				auto const height = footprint.bottom - footprint.top;
+				if (width * 4 < targetWidth * 3 || width * 2 > targetWidth * 3 + 4 ||
+					height * 4 < targetHeight * 3 || height * 2 > targetHeight * 3 + 4) {
+					continue;
+				}
+
+				for (int32_t alignY = 0; alignY < 3; ++alignY) {
+					for (int32_t alignX = 0; alignX < 3; ++alignX) {
+						auto left = bounds.left + (targetWidth - width) * alignX / 2;
+						auto top = bounds.top + (targetHeight - height) * alignY / 2;
+						ConvolutionScore candidate{ 0.0, left - footprint.left - padding, top - footprint.top - padding, kernel };
+						candidate.score = this->score(candidate);
+						if (candidate.score < m_minScore) {
+							continue;
+						}
+
+						auto merge = this->evaluate(candidate);
+						if (merge.removed.size() < 2) {
+							continue;
+						}
+						if (!best || merge.removed.size() > best->removed.size() ||
+							(merge.removed.size() == best->removed.size() && merge.error < best->error)) {
+							best = std::move(merge);
+						}
+					}
+				}
+			}
+		}
+
+		if (!best) {
+			return false;
+		}
+		this->add(best->placement);
+		for (auto removed : best->removed) {
+			this->uncover(m_placements[removed].score);
+			m_placements[removed].alive = false;
+		}
+		return true;
+	}
+
+	// smallest first, every placement the others cover well enough without
+	void drop() {
+		for (auto index : this->bySize()) {
+			if (m_error + this->removalCost(m_placements[index].score) <= m_budget + s_epsilon) {
+				this->uncover(m_placements[index].score);
+				m_placements[index].alive = false;
+			}
+		}
+	}
+
+	std::vector<size_t> bySize() const {
+		std::vector<size_t> ret;
+		for (size_t index = 0; index < m_placements.size(); ++index) {
+			if (m_placements[index].alive) {
+				ret.push_back(index);
+			}
+		}
+		std::stable_sort(ret.begin(), ret.end(), [&](size_t a, size_t b) {
+			return m_placements[a].count < m_placements[b].count;
+		});
+		return ret;
+	}
+
+	bool alive(size_t index) const {
+		return m_placements[index].alive;
+	}
+
+	std::vector<ConvolutionScore> scores() const {
+		std::vector<ConvolutionScore> ret;
+		for (auto const& placement : m_placements) {
+			if (placement.alive) {
+				ret.push_back(placement.score);
+			}
+		}
+		return ret;
+	}
+};
+
+ObjectReducer::ObjectReducer(std::vector<ObjectKernel> const& kernels) {
+	for (auto const& kernel : kernels) {
+		Footprint footprint;
+		footprint.left = kernel.width;
+		footprint.top = kernel.height;
+		for (int32_t y = 0; y < kernel.height; ++y) {
+			for (int32_t x = 0; x < kernel.width; ++x) {
+				auto weight = kernel.data[y * kernel.width + x];
+				if (weight <= 0.0) {
+					continue;
+				}
+				footprint.pixels.push_back({ x, y, weight });
+				footprint.left = std::min(footprint.left, x);
+				footprint.top = std::min(footprint.top, y);
+				footprint.right = std::max(footprint.right, x + 1);
+				footprint.bottom = std::max(footprint.bottom, y + 1);
+			}
+		}
+		if (footprint.pixels.empty()) {
+			footprint.left = 0;
+			footprint.top = 0;
+		}
+		m_padding = std::max({ m_padding, kernel.width, kernel.height });
+		m_footprints.push_back(std::move(footprint));
+	}
+}
+
+std::vector<ConvolutionScore> ObjectReducer::reduce(
+	double const* values, size_t width, size_t height, double background,
+	std::vector<ConvolutionScore> const& scores, double budget, double minScore
+) const {
+	if (scores.size() < 2) {
+		return scores;
+	}
+
+	Reduction reduction(*this, values, width, height, background, minScore);
+	reduction.setBudget(std::max(budget, 0.0));
+	for (auto const& score : scores) {
+		reduction.add(reduction.makePlacement(score));
+	}
+	// the greedy result is the baseline the budget is measured from
+	reduction.resetError();
+
+	// every merge removes at least one placement, so this ends
+	for (bool merged = true; merged;) {
+		merged = false;
+		for (auto index : reduction.bySize()) {
+			if (reduction.alive(index) && reduction.merge(index)) {
+				merged = true;
+			}
+		}
+	}
+	reduction.drop();
+
+	return reduction.scores();
+}
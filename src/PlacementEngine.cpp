@@ -0,0 +1,84 @@
+#include <PlacementEngine.hpp>
+#include <algorithm>
+
+using namespace tulip::text;
+
+PlacementEngine::PlacementEngine(
+	CorrelationMaps const& maps, std::vector<bool> active, double tolerance
+) :
+	m_maps(maps),
+	m_tolerance(tolerance),
+	m_active(std::move(active)),
+	m_stale(maps.size(), true),
+	m_peaks(maps.size()),
+	m_bounds(maps.size(), 0.0),
+	m_versions(maps.size(), 0) {
+	this->rebuild();
+}
+
+PlacementEngine::Entry PlacementEngine::evaluate(size_t kernel) {
+	++m_evaluations;
+
+	auto peak = m_maps.peak(kernel, m_tolerance, m_bounds[kernel]);
+	m_peaks[kernel] = { peak.score, peak.x, peak.y, kernel };
+	m_stale[kernel] = false;
+	return { peak.score, kernel, ++m_versions[kernel] };
+}
+
+void PlacementEngine::rebuild() {
+	m_queue = {};
+	for (size_t kernel = 0; kernel < m_maps.size(); ++kernel) {
+		if (m_active[kernel]) {
+			m_queue.push(this->evaluate(kernel));
+		}
+	}
+}
+
+std::optional<PlacementCandidate> PlacementEngine::next(double minScore) {
+	while (!m_queue.empty()) {
+		auto top = m_queue.top();
+		if (top.version != m_versions[top.kernel]) {
+			m_queue.pop();
+			continue;
+		}
+		if (top.key < minScore) {
+			// bounds never underestimate, so nothing below can reach minScore either
+			return std::nullopt;
+		}
+		if (!m_stale[top.kernel]) {
+			return m_peaks[top.kernel];
+		}
+
+		m_queue.pop();
+		m_queue.push(this->evaluate(top.kernel));
+	}
+	return std::nullopt;
+}
+
+void PlacementEngine::invalidate(std::vector<PixelChange> const& changes) {
+	if (changes.empty()) {
+		return;
+	}
+
+	bool const removedOnly = std::all_of(changes.begin(), changes.end(), [](PixelChange const& change) {
+		return change.delta <= 0.0;
+	});
+
+	for (size_t kernel = 0; kernel < m_maps.size(); ++kernel) {
+		if (!m_active[kernel]) {
+			continue;
+		}
+		if (!removedOnly || !m_maps.nonNegative(kernel)) {
+			// scores may have grown, old maxima are no longer upper bounds
+			this->rebuild();
+			return;
+		}
+
+		// every kernel has placements over a changed pixel, and a change anywhere in a map can move
+		// the peak the tolerance rule reports, so the map's maximum is all that still holds
+		if (!m_stale[kernel]) {
+			m_stale[kernel] = true;
+			m_queue.push({ m_bounds[kernel], kernel, ++m_versions[kernel] });
+		}
+	}
+}
@@ -0,0 +1,78 @@
+#include <Pyramid.hpp>
+
+#include <algorithm>
+
+using namespace tulip::text;
+
+std::vector<double> tulip::text::downsample(
+	double const* values, size_t width, size_t height, size_t factor, double background
+) {
+	auto const coarseWidth = downsampledSize(width, factor);
+	auto const coarseHeight = downsampledSize(height, factor);
+	auto const area = double(factor * factor);
+
+	std::vector<double> ret(coarseWidth * coarseHeight);
+	for (size_t coarseY = 0; coarseY < coarseHeight; ++coarseY) {
+		for (size_t coarseX = 0; coarseX < coarseWidth; ++coarseX) {
+			auto const left = coarseX * factor;
+			auto const top = coarseY * factor;
+			auto const right = std::min(left + factor, width);
+			auto const bottom = std::min(top + factor, height);
+
+			double sum = 0;
+			for (auto y = top; y < bottom; ++y) {
+				for (auto x = left; x < right; ++x) {
+					sum += values[y * width + x];
+				}
+			}
+			sum += background * (area - double((right - left) * (bottom - top)));
+			ret[coarseY * coarseWidth + coarseX] = sum / area;
+		}
+	}
+	return ret;
+}
+
+CorrelationPeak tulip::text::refinePeak(
+	double const* field, size_t width, size_t height, double background, double const* kernel,
+	size_t kernelWidth, size_t kernelHeight, int32_t left, int32_t top, int32_t right, int32_t bottom,
+	double tolerance
+) {
+	CorrelationPeak peak;
+
+	// the kernel total covers the part of a placement hanging over the edge
+	double kernelSum = 0;
+	for (size_t i = 0; i < kernelWidth * kernelHeight; ++i) {
+		kernelSum += kernel[i];
+	}
+
+	for (auto placementY = top; placementY <= bottom; ++placementY) {
+		for (auto placementX = left; placementX <= right; ++placementX) {
+			double score = 0;
+			double inside = 0;
+			for (size_t y = 0; y < kernelHeight; ++y) {
+				auto const fieldY = int64_t(placementY) + int64_t(y);
+				if (fieldY < 0 || fieldY >= int64_t(height)) {
+					continue;
+				}
+
+				auto const fieldRow = field + fieldY * int64_t(width);
+				auto const kernelRow = kernel + y * kernelWidth;
+				auto const begin = size_t(std::max<int64_t>(0, -int64_t(placementX)));
+				auto const end = size_t(std::clamp<int64_t>(int64_t(width) - placementX, 0, int64_t(kernelWidth)));
+				for (auto x = begin; x < end; ++x) {
+					score += kernelRow[x] * fieldRow[placementX + int64_t(x)];
+					inside += kernelRow[x];
+				}
+			}
+			score += background * (kernelSum - inside);
+
+			if (score > peak.score + tolerance) {
+				peak.score = score;
+				peak.x = placementX;
+				peak.y = placementY;
+			}
+		}
+	}
+
+	return peak;
+}
@@ -0,0 +1,174 @@
+#include <CorrelationMaps.hpp>
+#include <PlacementEngine.hpp>
+#include <cstdio>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace tulip::text;
+
+// the lazy PlacementEngine has to pick what the full greedy scan picks at every step
+// inputs are drawn from a few close values so peaks sit within the tolerance of each other
+
+namespace {
+	constexpr double s_background = -1.0;
+	constexpr double s_minScore = 2.0;
+	constexpr double s_tolerance = 0.1;
+	constexpr size_t s_steps = 40;
+	constexpr unsigned s_seeds = 300;
+
+	struct Input {
+		size_t width;
+		size_t height;
+		std::vector<double> values;
+
+		double at(int64_t x, int64_t y) const {
+			if (x < 0 || y < 0 || x >= int64_t(width) || y >= int64_t(height)) {
+				return s_background;
+			}
+			return values[y * width + x];
+		}
+	};
+
+	std::vector<ObjectKernel> randomKernels(std::mt19937& random) {
+		std::vector<ObjectKernel> ret;
+		std::uniform_int_distribution<int32_t> size(2, 6);
+		std::bernoulli_distribution set(0.7);
+		std::bernoulli_distribution half(0.2);
+		for (size_t i = 0; i < 8; ++i) {
+			ObjectKernel kernel{};
+			kernel.width = size(random);
+			kernel.height = size(random);
+			kernel.data.assign(size_t(kernel.width * kernel.height), 0.0);
+			// every other kernel is a solid rectangle, the rest have holes and lighter pixels
+			for (auto& weight : kernel.data) {
+				if (i % 2 == 0 || set(random)) {
+					weight = i % 2 == 1 && half(random) ? 0.5 : 1.0;
+				}
+			}
+			ret.push_back(std::move(kernel));
+		}
+		return ret;
+	}
+
+	Input randomInput(std::mt19937& random) {
+		std::uniform_int_distribution<size_t> size(16, 32);
+		std::bernoulli_distribution glyph(0.7);
+		std::uniform_int_distribution<int> shade(0, 3);
+
+		Input ret{ size(random), size(random), {} };
+		for (size_t i = 0; i < ret.width * ret.height; ++i) {
+			ret.values.push_back(glyph(random) ? 1.0 - 0.01 * shade(random) : s_background);
+		}
+		return ret;
+	}
+
+	void correlate(Input const& input, ObjectKernel const& kernel, Matrix<double>& map) {
+		for (size_t mapY = 0; mapY < map.height; ++mapY) {
+			for (size_t mapX = 0; mapX < map.width; ++mapX) {
+				auto const left = int64_t(mapX) - kernel.width + 1;
+				auto const top = int64_t(mapY) - kernel.height + 1;
+				double score = 0.0;
+				for (int32_t y = 0; y < kernel.height; ++y) {
+					for (int32_t x = 0; x < kernel.width; ++x) {
+						score += kernel.data[y * kernel.width + x] * input.at(left + x, top + y);
+					}
+				}
+				map(mapX, mapY) = score;
+			}
+		}
+	}
+
+	// what Generator does without incremental scoring: every kernel's peak, the best one wins
+	// with ties to the later kernel
+	std::optional<PlacementCandidate> fullScan(CorrelationMaps const& maps) {
+		std::optional<PlacementCandidate> ret;
+		for (size_t kernel = 0; kernel < maps.size(); ++kernel) {
+			double maximum = 0.0;
+			auto peak = maps.peak(kernel, s_tolerance, maximum);
+			if (!ret || peak.score >= ret->score) {
+				ret = PlacementCandidate{ peak.score, peak.x, peak.y, kernel };
+			}
+		}
+		if (!ret || ret->score < s_minScore) {
+			return std::nullopt;
+		}
+		return ret;
+	}
+
+	std::vector<PixelChange> place(Input& input, ObjectKernel const& kernel, PlacementCandidate const& candidate) {
+		std::vector<PixelChange> ret;
+		for (int32_t y = 0; y < kernel.height; ++y) {
+			for (int32_t x = 0; x < kernel.width; ++x) {
+				auto const inputX = candidate.x + x;
+				auto const inputY = candidate.y + y;
+				if (kernel.data[y * kernel.width + x] <= 0.0 || input.at(inputX, inputY) <= 0.0) {
+					continue;
+				}
+				auto& value = input.values[inputY * input.width + inputX];
+				ret.push_back({ inputX, inputY, -value });
+				value = 0.0;
+			}
+		}
+		return ret;
+	}
+
+	bool run(unsigned seed) {
+		std::mt19937 random(seed);
+		auto const kernels = randomKernels(random);
+		auto input = randomInput(random);
+
+		std::vector<bool> active(kernels.size(), true);
+		CorrelationMaps maps(kernels, active, input.width, input.height);
+		for (size_t kernel = 0; kernel < kernels.size(); ++kernel) {
+			correlate(input, kernels[kernel], maps[kernel]);
+		}
+		PlacementEngine engine(maps, active, s_tolerance);
+
+		for (size_t step = 0; step < s_steps; ++step) {
+			auto const full = fullScan(maps);
+			auto const lazy = engine.next(s_minScore);
+			if (full.has_value() != lazy.has_value() ||
+				(full && (full->kernel != lazy->kernel || full->x != lazy->x || full->y != lazy->y))) {
+				auto describe = [](std::optional<PlacementCandidate> const& candidate) {
+					if (!candidate) {
+						return std::string("nothing");
+					}
+					char buffer[96];
+					std::snprintf(
+						buffer, sizeof(buffer), "k%zu (%d, %d) = %f", candidate->kernel, candidate->x, candidate->y,
+						candidate->score
+					);
+					return std::string(buffer);
+				};
+				std::printf(
+					"seed %u step %zu: full picked %s, lazy picked %s\n", seed, step, describe(full).c_str(),
+					describe(lazy).c_str()
+				);
+				return false;
+			}
+			if (!full) {
+				break;
+			}
+
+			auto const changes = place(input, kernels[full->kernel], *full);
+			for (size_t kernel = 0; kernel < kernels.size(); ++kernel) {
+				maps.update(kernel, changes);
+			}
+			engine.invalidate(changes);
+		}
+		return true;
+	}
+}
+
+int main() {
+	unsigned failed = 0;
+	for (unsigned seed = 0; seed < s_seeds; ++seed) {
+		if (!run(seed)) {
+			++failed;
+		}
+	}
+	std::printf("%u of %u runs differ from the full scan\n", failed, s_seeds);
+	return failed == 0 ? 0 : 1;
+}
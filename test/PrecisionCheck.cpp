@@ -0,0 +1,222 @@
+#include <GlyphDecomposer.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace tulip::text;
+
+// GlyphDecomposer with Precision::Single has to place what it places with Precision::Double on a set of
+// reference glyphs, through incremental scoring, the full scan, placement batches and the pyramid search
+// scores are compared with a tolerance: where both precisions see a near tie they may break it differently,
+// from there on they decompose different rasters and only have to end up alike
+
+namespace {
+	constexpr double s_negativeScore = -5.0;
+	constexpr double s_minScore = 10.0;
+	constexpr size_t s_maxObjects = 50;
+
+	// float transforms lose about seven digits, scores are sums of at most a few hundred pixels
+	double scoreTolerance(double score) {
+		return 1e-3 * std::max(1.0, std::abs(score));
+	}
+
+	struct Mode {
+		std::string name;
+		std::function<void(GeneratorConfig&)> apply;
+	};
+
+	GlyphVector2D makeGlyph(size_t size, std::function<bool(double, double)> inside) {
+		GlyphVector2D ret{ std::vector<double>(size * size, s_negativeScore), size, size, 0 };
+		for (size_t y = 0; y < size; ++y) {
+			for (size_t x = 0; x < size; ++x) {
+				if (inside(double(x) / size, double(y) / size)) {
+					ret.data[y * size + x] = 1.0;
+				}
+			}
+		}
+		return ret;
+	}
+
+	std::vector<std::pair<std::string, GlyphVector2D>> referenceGlyphs() {
+		std::vector<std::pair<std::string, GlyphVector2D>> ret;
+		ret.emplace_back("ring", makeGlyph(96, [](double x, double y) {
+			auto distance = std::hypot(x - 0.5, y - 0.5);
+			return distance > 0.3 && distance < 0.45;
+		}));
+		ret.emplace_back("cross", makeGlyph(80, [](double x, double y) {
+			return (x > 0.4 && x < 0.6) || (y > 0.4 && y < 0.6);
+		}));
+		ret.emplace_back("stroke", makeGlyph(90, [](double x, double y) {
+			return std::abs(x - y) < 0.12 && x > 0.1 && x < 0.9;
+		}));
+		ret.emplace_back("e", makeGlyph(100, [](double x, double y) {
+			if (x < 0.15 || x > 0.85 || y < 0.1 || y > 0.9) {
+				return false;
+			}
+			return x < 0.35 || y < 0.25 || (y > 0.42 && y < 0.58 && x < 0.7) || y > 0.75;
+		}));
+		ret.emplace_back("dots", makeGlyph(72, [](double x, double y) {
+			auto dot = [&](double cx, double cy) {
+				return std::hypot(x - cx, y - cy) < 0.13;
+			};
+			return dot(0.25, 0.25) || dot(0.7, 0.3) || dot(0.4, 0.72);
+		}));
+		return ret;
+	}
+
+	std::vector<ObjectKernel> referenceKernels() {
+		std::vector<ObjectKernel> ret;
+		auto add = [&](int32_t width, int32_t height, std::function<double(int32_t, int32_t)> weight) {
+			ObjectKernel kernel{};
+			kernel.width = width;
+			kernel.height = height;
+			for (int32_t y = 0; y < height; ++y) {
+				for (int32_t x = 0; x < width; ++x) {
+					kernel.data.push_back(weight(x, y));
+				}
+			}
+			ret.push_back(std::move(kernel));
+		};
+		auto solid = [](int32_t, int32_t) {
+			return 1.0;
+		};
+
+		// solid rectangles are scored from the integral image, the rest through the transforms
+		for (int32_t size = 6; size <= 20; size += 4) {
+			add(size, size, solid);
+		}
+		add(4, 16, solid);
+		add(16, 4, solid);
+		for (int32_t size : { 11, 17 }) {
+			auto const half = (size - 1) / 2;
+			add(size, size, [=](int32_t x, int32_t y) {
+				return std::abs(x - half) + std::abs(y - half) <= half ? 1.0 : 0.0;
+			});
+		}
+		add(14, 14, [](int32_t x, int32_t y) {
+			return x < 3 || y < 3 || x >= 11 || y >= 11 ? 1.0 : 0.0;
+		});
+		add(12, 8, [](int32_t x, int32_t y) {
+			return (x + y) % 3 == 0 ? 0.5 : 1.0;
+		});
+		return ret;
+	}
+
+	std::vector<Mode> modes() {
+		return {
+			{ "incremental", [](GeneratorConfig& config) {
+				config.incrementalScoring = true;
+			} },
+			{ "full scan", [](GeneratorConfig& config) {
+				config.incrementalScoring = false;
+			} },
+			{ "batch", [](GeneratorConfig& config) {
+				config.incrementalScoring = false;
+				config.placementBatch = 3;
+			} },
+			{ "pyramid", [](GeneratorConfig& config) {
+				config.pyramidFactor = 2;
+				config.pyramidCandidates = 6;
+			} },
+		};
+	}
+
+	struct Result {
+		std::vector<ConvolutionScore> scores;
+		size_t uncovered;
+	};
+
+	Result decompose(
+		GlyphDecomposer& decomposer, GlyphVector2D glyph, std::vector<ObjectKernel> const& kernels, Mode const& mode,
+		Precision precision
+	) {
+		GeneratorConfig config;
+		config.kernels = kernels;
+		config.minScore = s_minScore;
+		config.negativeScore = s_negativeScore;
+		config.precision = precision;
+		mode.apply(config);
+
+		auto scores = decomposer.decompose(glyph, config, s_maxObjects);
+		return { std::move(scores), countPositive(glyph) };
+	}
+
+	// whether single follows reference up to a near tie or a score near minScore
+	bool compare(std::string const& name, Result const& reference, Result const& single, size_t glyphPixels) {
+		auto const& a = reference.scores;
+		auto const& b = single.scores;
+
+		size_t index = 0;
+		while (index < a.size() && index < b.size() && a[index].kernelId == b[index].kernelId &&
+			a[index].x == b[index].x && a[index].y == b[index].y &&
+			std::abs(a[index].score - b[index].score) <= scoreTolerance(a[index].score)) {
+			++index;
+		}
+		if (index == a.size() && index == b.size()) {
+			std::printf("%s: %zu placements match\n", name.c_str(), a.size());
+			return true;
+		}
+
+		if (index < a.size() && index < b.size()) {
+			auto const& x = a[index];
+			auto const& y = b[index];
+			if (std::abs(x.score - y.score) > scoreTolerance(x.score)) {
+				std::printf(
+					"%s: placement %zu differs, double kernel %zu at %d, %d scoring %f, float kernel %zu at %d, %d scoring %f\n",
+					name.c_str(), index, x.kernelId, x.x, x.y, x.score, y.kernelId, y.x, y.y, y.score
+				);
+				return false;
+			}
+		}
+		else {
+			// one stopped where the other still placed, which only a score at minScore can do
+			auto const& extra = index < a.size() ? a[index] : b[index];
+			if (std::abs(extra.score - s_minScore) > scoreTolerance(s_minScore)) {
+				std::printf(
+					"%s: %zu double placements, %zu float, the extra one scoring %f\n", name.c_str(), a.size(), b.size(),
+					extra.score
+				);
+				return false;
+			}
+		}
+
+		// past a near tie both are greedy decompositions of the same glyph
+		auto const countDifference = std::max(a.size(), b.size()) - std::min(a.size(), b.size());
+		auto const uncoveredDifference = std::max(reference.uncovered, single.uncovered) -
+			std::min(reference.uncovered, single.uncovered);
+		if (countDifference > 2 + a.size() / 10 || uncoveredDifference > glyphPixels / 50) {
+			std::printf(
+				"%s: near tie at placement %zu, then %zu double placements leaving %zu pixels, %zu float leaving %zu\n",
+				name.c_str(), index, a.size(), reference.uncovered, b.size(), single.uncovered
+			);
+			return false;
+		}
+		std::printf(
+			"%s: %zu placements match up to a near tie, %zu double and %zu float in all\n", name.c_str(), index, a.size(),
+			b.size()
+		);
+		return true;
+	}
+}
+
+int main() {
+	auto const kernels = referenceKernels();
+	GlyphDecomposer decomposer;
+	decomposer.setKernels(kernels);
+
+	bool passed = true;
+	for (auto const& mode : modes()) {
+		for (auto const& [name, glyph] : referenceGlyphs()) {
+			auto const reference = decompose(decomposer, glyph, kernels, mode, Precision::Double);
+			auto const single = decompose(decomposer, glyph, kernels, mode, Precision::Single);
+			if (!compare(mode.name + ", " + name, reference, single, countPositive(glyph))) {
+				passed = false;
+			}
+		}
+	}
+
+	return passed ? 0 : 1;
+}